@@ -0,0 +1,396 @@
+/**
+ * @author Petr Lavicka
+ * @copyright
+ * @file
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "config.h"
+#include "path.h"
+#include "random.h"
+#include "solver.h"
+#include "speculative.h"
+#include "stream.h"
+#include "trace.h"
+#include "watchdog.h"
+
+extern config g_config;
+extern std::atomic<bool> g_continue_run;
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static constexpr double get_last_t(std::size_t cities)
+{
+    if (cities < 55)
+        return 0.005;
+
+    if (cities < 105)
+        return 0.002;
+
+    return 0.001;
+}
+
+// Scalar part of the annealing state, saved in checkpoints together with
+// the actual and the best path.
+// The layout has no padding, so equal states have equal images.
+struct anneal_state_t
+{
+    double actual_T;
+    std::uint64_t rng_state[2];
+    std::uint32_t iter;
+    std::uint32_t actual_cost;
+    std::uint32_t min_cost;
+    // Shift of the cooling schedule by the reheats (in iterations).
+    std::uint32_t shift;
+
+    // Stagnation monitor, the accepted moves of the block are counted
+    // since its start (the statistics of a resumed run start from zero).
+    double improvement_T;
+    double accept_ratio;
+    std::uint32_t last_improvement;
+    std::uint32_t block_accepted;
+    std::uint32_t reheats;
+    std::uint32_t stalls;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Simulated annealing, the moves are proposed and priced by the path.
+template <typename Path>
+class annealing_t
+{
+public:
+    // Improving solutions are published to the stream (if any) during the run.
+    // The state is saved to the checkpoint file periodically, on request
+    // and at the end, the run continues from the resume file if it is set.
+    // Only the chain zero works with the checkpoints when more chains run
+    // in parallel, the others differ in the seed. The stop flag is checked
+    // at the temperature recompute, where the best path is also handed over
+    // to the snapshot (if any) for the output on time.
+    //
+    // A chain stagnates when it hasn't improved the best path for long and
+    // (almost) no move is accepted any more. Then the cooling schedule is
+    // moved back to the temperature of the last improvement (1.5 times higher
+    // with every further stagnation in a row) and every second time in a row
+    // the chain also restarts from the best path perturbed by random swaps.
+    // The number of these reheats is limited.
+    solver_stats_t run(Path & path, const solver_context_t & context)
+    {
+        solver_stats_t stats;
+
+        auto stream = context.stream;
+        auto chain = context.chain;
+        auto snapshot = context.snapshot;
+
+        rnd_gen_t rng(chain_seed(chain));
+
+        // The screening gives the same trajectory (the speculative helpers price the moves exactly).
+        const bool screening = (context.screen && g_config.speculative <= 0);
+        if (screening)
+            path.use_screening(context.screen);
+
+        auto min_path = path;
+        auto min_cost = path.cost();
+
+        std::vector<std::uint16_t> min_route;
+
+        auto actual_cost = min_cost;
+
+        // Some constants for temperature computing.
+        auto Tn = /*g_config.iterations*/ 80'000'000;
+        auto exp_base = std::log(get_last_t(path.size()));
+
+        double actual_T = 1.0;
+
+        unsigned int iter = 0;
+        unsigned int shift = 0;
+
+        // Stagnation monitor.
+        const auto stall_iterations = g_config.stall_iterations ? static_cast<unsigned int>(g_config.stall_iterations)
+                                                                : std::max(200'000u, 2'000u * static_cast<unsigned int>(path.size()));
+        auto last_improvement = iter;
+        auto improvement_T = actual_T;
+        std::uint64_t accepted = 0;
+        double accept_ratio = 1.0;
+        int reheats = 0;
+        unsigned int stalls = 0;
+
+        if (chain == 0 && !g_config.resume_file.empty())
+        {
+            anneal_state_t state;
+            if (path.load_checkpoint(g_config.resume_file, state, min_path))
+            {
+                iter = state.iter;
+                actual_T = state.actual_T;
+                rng.set_state(state.rng_state);
+                actual_cost = state.actual_cost;
+                min_cost = state.min_cost;
+                shift = state.shift;
+                improvement_T = state.improvement_T;
+                accept_ratio = state.accept_ratio;
+                last_improvement = state.last_improvement;
+                accepted = accepted_count(stats) - state.block_accepted;
+                reheats = static_cast<int>(state.reheats);
+                stalls = state.stalls;
+
+                // The prices have changed, continue from the best path at a low temperature.
+                if (!g_config.delta_file.empty())
+                {
+                    path = min_path;
+                    min_cost = path.cost();
+                    actual_cost = min_cost;
+                    iter = warm_iteration(g_config.warm_T, exp_base, Tn);
+                    shift = 0;
+
+                    last_improvement = iter;
+                    improvement_T = actual_T;
+                    accepted = accepted_count(stats);
+                    accept_ratio = 1.0;
+                    reheats = 0;
+                    stalls = 0;
+
+                    if (g_config.debug)
+                        std::cerr << "warm start: cost " << min_cost << ", iteration " << iter << std::endl;
+                }
+            }
+            else
+                std::cerr << "Cannot resume from: " << g_config.resume_file << std::endl;
+        }
+
+        auto checkpoint = [&]
+        {
+            anneal_state_t state;
+            state.iter = iter;
+            state.actual_T = actual_T;
+            rng.get_state(state.rng_state);
+            state.actual_cost = actual_cost;
+            state.min_cost = min_cost;
+            state.shift = shift;
+            state.improvement_T = improvement_T;
+            state.accept_ratio = accept_ratio;
+            state.last_improvement = last_improvement;
+            state.block_accepted = static_cast<std::uint32_t>(accepted_count(stats) - accepted);
+            state.reheats = static_cast<std::uint32_t>(reheats);
+            state.stalls = stalls;
+
+            if (!path.save_checkpoint(g_config.checkpoint_file, state, min_path))
+                std::cerr << "Cannot save the checkpoint: " << g_config.checkpoint_file << std::endl;
+        };
+
+        auto on_accept = [&](const typename Path::move_t & move)
+        {
+            ++stats.accepted[move.method];
+            actual_cost += move.cost_diff;
+
+            // If the actual path cost is the best one, save it.
+            if (actual_cost < min_cost)
+            {
+                min_path = path;
+                min_cost = actual_cost;
+
+                last_improvement = iter;
+                improvement_T = actual_T;
+                stalls = 0;
+
+                if (stream && stream->wants(min_cost))
+                {
+                    path.route(min_route);
+                    stream->publish(min_cost, min_route);
+                }
+            }
+        };
+
+        // Helper threads evaluating the proposals ahead.
+        std::unique_ptr<speculative_evaluator_t<Path>> speculative;
+        std::vector<std::uint64_t> xrnds;
+        if (g_config.speculative > 0)
+        {
+            speculative = std::make_unique<speculative_evaluator_t<Path>>(path, g_config.speculative);
+            xrnds.resize(std::min<std::size_t>(std::max(g_config.speculative_batch, 1), speculative_evaluator_t<Path>::max_batch));
+        }
+
+        const auto first_iter = iter;
+        const auto max_iterations = g_config.max_iterations;
+        const bool checkpoints = (chain == 0 && !g_config.checkpoint_file.empty());
+        const auto checkpoint_period = std::chrono::milliseconds(g_config.checkpoint_period);
+        auto next_checkpoint = std::chrono::steady_clock::now() + checkpoint_period;
+
+        // The run is split to the epochs of the iterations in the trace.
+        const unsigned int trace_epoch = 1 << 20;
+        auto epoch_begin = trace_t::clock_t::now();
+        auto trace_epoch_end = [&]
+        {
+            auto now = trace_t::clock_t::now();
+
+            std::string args;
+            trace_t::arg(args, "iteration", iter);
+            trace_t::arg(args, "T", actual_T);
+            trace_t::arg(args, "cost", actual_cost);
+            trace_t::arg(args, "min_cost", min_cost);
+            g_trace.add("anneal epoch", epoch_begin, now, std::move(args));
+
+            epoch_begin = now;
+        };
+
+        while (true)
+        {
+            if (iter % 512 /*g_config.recomp_T*/ == 0)
+            {
+                if (!g_continue_run.load(std::memory_order_relaxed) || (max_iterations && iter - first_iter >= max_iterations))
+                    break;
+
+                if (g_trace.enabled() && iter % trace_epoch == 0 && iter != first_iter)
+                    trace_epoch_end();
+
+                if (snapshot && snapshot->wants(min_cost))
+                {
+                    min_path.route(min_route);
+                    snapshot->publish(min_cost, min_route);
+                }
+
+                // The state is saved before the iteration (a resumed run continues from here).
+                if (checkpoints && (g_checkpoint_request.exchange(false)
+                    || (checkpoint_period.count() && std::chrono::steady_clock::now() >= next_checkpoint)))
+                {
+                    checkpoint();
+                    next_checkpoint = std::chrono::steady_clock::now() + checkpoint_period;
+                }
+
+                if (reheats < g_config.max_reheats)
+                {
+                    // Smoothed ratio of the accepted moves of the blocks.
+                    auto accepted_now = accepted_count(stats);
+                    accept_ratio = 0.9 * accept_ratio + 0.1 * (accepted_now - accepted) / 512.0;
+                    accepted = accepted_now;
+
+                    if (iter - last_improvement >= stall_iterations && accept_ratio < g_config.stall_accept)
+                    {
+                        auto T = std::min(1.0, std::max(improvement_T, actual_T) * std::pow(1.5, stalls));
+                        shift = iter - warm_iteration(T, exp_base, Tn);
+
+                        bool restart = (stalls % 2 == 1);
+                        if (restart)
+                        {
+                            path = min_path;
+                            actual_cost = min_cost + perturb(path, static_cast<typename Path::index_t>(path.size() - 2), rng);
+
+                            // The helpers replay the moves only, they need the new path.
+                            if (speculative)
+                            {
+                                speculative.reset();
+                                speculative = std::make_unique<speculative_evaluator_t<Path>>(path, g_config.speculative);
+                            }
+                        }
+
+                        if (g_config.debug)
+                            std::cerr << "chain " << chain << ": " << (restart ? "restart" : "reheat") << " at iteration " << iter
+                                      << " to T " << T << ", best cost " << min_cost << std::endl;
+
+                        ++reheats;
+                        ++stalls;
+                        last_improvement = iter;
+                        accept_ratio = 1.0;
+                    }
+                }
+
+                actual_T = std::exp(exp_base * std::pow((iter - shift + 1) / (double)Tn, 0.3));
+            }
+            // Evaluate the whole block (up to the next temperature recompute) speculatively.
+            if (speculative)
+            {
+                auto block_end = iter + 512 - iter % 512;
+                while (iter < block_end)
+                {
+                    // Look ahead in the random sequence, the generator itself advances only by the iterations done.
+                    auto count = std::min<unsigned int>(block_end - iter, static_cast<unsigned int>(xrnds.size()));
+                    auto lookahead = rng;
+                    for (unsigned int k = 0; k < count; ++k)
+                        xrnds[k] = lookahead();
+
+                    auto k = speculative->first_accepted(xrnds.data(), count, actual_T);
+                    for (unsigned int l = 0; l < k; ++l)
+                        rng();
+                    iter += static_cast<unsigned int>(k);
+
+                    if (k < count)
+                    {
+                        rng();
+                        ++iter;
+
+                        auto move = path.propose(xrnds[k]);
+                        path.apply(move);
+                        speculative->commit(move);
+                        on_accept(move);
+                    }
+                }
+                continue;
+            }
+
+            ++iter;
+
+            auto xrnd = rng();
+            auto move = screening ? path.template propose<true>(xrnd, path.acceptance_limit(xrnd, actual_T)) : path.propose(xrnd);
+
+            // If the new path should be accepted, save it.
+            if (path.accept(move, xrnd, actual_T))
+            {
+                path.apply(move);
+                on_accept(move);
+            }
+        }
+        //std::cout << "pocet iteraci (new): " << iter << std::endl;
+        stats.iterations = iter - first_iter;
+        if (g_trace.enabled())
+            trace_epoch_end();
+        if (checkpoints)
+            checkpoint();
+
+        path = min_path;
+        assert(min_cost == path.cost());
+
+        if (stream)
+        {
+            path.route(min_route);
+            stream->publish_final(min_cost, min_route);
+        }
+        return stats;
+    }
+
+private:
+    static std::uint64_t accepted_count(const solver_stats_t & stats) noexcept
+    {
+        std::uint64_t sum = 0;
+        for (auto count : stats.accepted)
+            sum += count;
+        return sum;
+    }
+
+    // The first iteration with the temperature at most T (inverse of the cooling schedule).
+    static unsigned int warm_iteration(double T, double exp_base, unsigned int Tn)
+    {
+        assert(T > 0);
+        if (T >= 1.0)
+            return 0;
+
+        auto iter = Tn * std::pow(std::log(T) / exp_base, 1 / 0.3);
+        if (iter >= std::numeric_limits<unsigned int>::max())
+            return std::numeric_limits<unsigned int>::max() & ~511u;
+
+        // Aligned to the temperature recompute.
+        return static_cast<unsigned int>(iter) & ~511u;
+    }
+};
@@ -0,0 +1,65 @@
+# Comparison of the search engines by the size tiers: python bench.py ./kiwi [runs]
+# Generates random instances (every flight with the probability 1/2 at 10..900,
+# the same ones for the same seed), runs the program with every engine for the
+# tier and prints the costs (the time limits of the tiers, the seeds by time).
+import os, random, subprocess, sys, tempfile
+
+# (seed, areas, max cities per area)
+INSTANCES = [(1, 12, 3), (2, 16, 2), (3, 20, 2),
+             (4, 40, 3), (5, 70, 2), (6, 100, 1),
+             (7, 120, 2), (8, 150, 1), (9, 200, 1)]
+ENGINES = ['anneal', 'tabu']
+
+
+def code(i):
+    return chr(65 + i // 676) + chr(65 + (i // 26) % 26) + chr(65 + i % 26)
+
+
+def generate(out, seed, n, k):
+    random.seed(seed)
+    areas = []
+    c = 0
+    for a in range(n):
+        size = 1 if a == 0 else random.randint(1, k)
+        areas.append([code(c + j) for j in range(size)])
+        c += size
+    out.write('%d %s\n' % (n, areas[0][0]))
+    for a, area in enumerate(areas):
+        out.write('area%d\n%s\n' % (a, ' '.join(area)))
+    cities = [x for area in areas for x in area]
+    for day in range(1, n + 1):
+        for src in cities:
+            for dst in cities:
+                if src != dst and random.random() < 0.5:
+                    out.write('%s %s %d %d\n' % (src, dst, day, random.randint(10, 900)))
+
+
+def solve(program, instance, engine):
+    with tempfile.NamedTemporaryFile('w', suffix='.txt', delete=False) as config:
+        config.write('engine_small=%s\nengine_medium=%s\nengine_large=%s\n' % (engine, engine, engine))
+    try:
+        with open(instance) as stdin:
+            out = subprocess.run([program, config.name], stdin=stdin, stdout=subprocess.PIPE,
+                                 stderr=subprocess.DEVNULL, universal_newlines=True, check=True).stdout
+    finally:
+        os.remove(config.name)
+    return int(out.split()[0])
+
+
+def main():
+    program = sys.argv[1]
+    runs = int(sys.argv[2]) if len(sys.argv) > 2 else 2
+    print('| instance | ' + ' | '.join(ENGINES) + ' |')
+    print('|---' * (len(ENGINES) + 1) + '|')
+    for seed, n, k in INSTANCES:
+        with tempfile.NamedTemporaryFile('w', suffix='.txt', delete=False) as instance:
+            generate(instance, seed, n, k)
+        try:
+            costs = [[solve(program, instance.name, engine) for _ in range(runs)] for engine in ENGINES]
+        finally:
+            os.remove(instance.name)
+        print('| %d areas, 1-%d cities | ' % (n, k) + ' | '.join(', '.join(map(str, c)) for c in costs) + ' |')
+
+
+if __name__ == '__main__':
+    main()
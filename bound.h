@@ -0,0 +1,349 @@
+/**
+ * @author Petr Lavicka
+ * @copyright
+ * @file
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "city.h"
+#include "matrix.h"
+
+extern std::atomic<bool> g_continue_run;
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Lower bound of the cost of any path (the missing flights count by their
+// price in the matrix, as in the path cost).
+//
+// The price of every flight is split to the part of the day it enters (given
+// by the multiplier of the day and the entered city) and the rest, which is
+// left to the city the flight leaves. Every position of the path then costs
+// at least the cheapest city of its area with its parts, so the assignment
+// of the areas to the days (the Hungarian method) bounds the whole path. The
+// multipliers are tightened by the subgradient method, the bound is valid
+// for any of them.
+class lower_bound_t
+{
+public:
+    lower_bound_t(const std::vector<area_t> & areas_list, std::size_t cities_count, const matrix<std::uint16_t> * costs_matrix)
+        : m_days(areas_list.size())
+        , m_cities(cities_count)
+        , m_area_of(cities_count, -1)
+        , m_start(areas_list[0].begin(), areas_list[0].end())
+        , m_costs{costs_matrix}
+    {
+        for (std::size_t a = 0; a < areas_list.size(); ++a)
+            for (auto city : areas_list[a])
+            {
+                m_area_of[city] = static_cast<int>(a);
+                if (a > 0)
+                    m_middle.push_back(city);
+            }
+    }
+
+    // The cheapest flight of every day among the ones a path can take.
+    std::uint32_t per_day() const
+    {
+        std::uint32_t sum = 0;
+        for (std::size_t day = 0; day < m_days; ++day)
+        {
+            std::int32_t best = std::numeric_limits<std::int32_t>::max();
+            for_each_flight(day, [&](std::uint16_t from, std::uint16_t to)
+            {
+                best = std::min(best, m_costs->get(from, to, static_cast<unsigned int>(day)));
+            });
+            sum += best;
+        }
+        return sum;
+    }
+
+    // Reports every better bound, ends when the bound can't be improved, after
+    // the rounds or on the stop (unless it isn't interruptible). The upper
+    // bound (the best known cost) directs the steps.
+    template <typename Report, typename Upper>
+    void run(Report && report, Upper && upper_bound, unsigned int max_rounds = 1000, bool interruptible = true)
+    {
+        m_interruptible = interruptible;
+        auto best = per_day();
+        report(best);
+
+        // Start with the cheapest entering flights (the rest of the prices is non-negative).
+        m_lambda.assign(m_days * m_cities, 0.0);
+        for (std::size_t day = 0; day < m_days; ++day)
+        {
+            for (std::size_t city = 0; city < m_cities; ++city)
+                lambda(day, city) = std::numeric_limits<double>::max();
+
+            for_each_flight(day, [&](std::uint16_t from, std::uint16_t to)
+            {
+                lambda(day, to) = std::min(lambda(day, to), static_cast<double>(m_costs->get(from, to, static_cast<unsigned int>(day))));
+            });
+
+            for (std::size_t city = 0; city < m_cities; ++city)
+                if (lambda(day, city) == std::numeric_limits<double>::max())
+                    lambda(day, city) = 0;
+        }
+
+        double theta = 2.0;
+        unsigned int stalled = 0;
+        double best_value = 0;
+
+        std::vector<std::uint16_t> entered, left;
+        for (unsigned int round = 0; round < max_rounds && theta > 0.005; ++round)
+        {
+            double value;
+            if (!evaluate(value, entered, left))
+                return;
+
+            // The prices are integral.
+            auto bound = std::ceil(value - 1e-6);
+            if (bound > best)
+            {
+                best = static_cast<std::uint32_t>(bound);
+                report(best);
+            }
+
+            auto upper = upper_bound();
+            if (best >= upper)
+                return;
+
+            if (value > best_value + 1e-6)
+            {
+                best_value = value;
+                stalled = 0;
+            }
+            else if (++stalled >= 10)
+            {
+                theta /= 2;
+                stalled = 0;
+            }
+
+            // Subgradient: the city entered on the day by the assignment differs from the one the left part expects.
+            std::size_t norm = 0;
+            for (std::size_t day = 0; day < m_days; ++day)
+                if (entered[day] != left[day])
+                    norm += 2;
+
+            // The relaxed solution is a path, so the bound is exact.
+            if (norm == 0)
+                return;
+
+            auto target = (upper == std::numeric_limits<std::uint32_t>::max()) ? value * 1.05 + 1 : static_cast<double>(upper);
+            auto step = theta * std::max(target - value, 1.0) / norm;
+            for (std::size_t day = 0; day < m_days; ++day)
+            {
+                if (entered[day] != left[day])
+                {
+                    lambda(day, entered[day]) += step;
+                    lambda(day, left[day]) -= step;
+                }
+            }
+        }
+    }
+
+private:
+    double & lambda(std::size_t day, std::size_t city)
+    {
+        return m_lambda[day * m_cities + city];
+    }
+
+    // Calls fn(from, to) for the flights of the day a path can take.
+    template <typename Fn>
+    void for_each_flight(std::size_t day, Fn && fn) const
+    {
+        if (day == 0)
+        {
+            for_each_next(day, 0, fn);
+            return;
+        }
+
+        for (auto from : m_middle)
+            for_each_next(day, from, fn);
+    }
+
+    // Calls fn(from, to) for the cities a path can go to from the city on the day.
+    template <typename Fn>
+    void for_each_next(std::size_t day, std::uint16_t from, Fn && fn) const
+    {
+        if (day + 1 == m_days)
+        {
+            for (auto to : m_start)
+                fn(from, to);
+            return;
+        }
+
+        for (auto to : m_middle)
+            if (m_area_of[to] != m_area_of[from])
+                fn(from, to);
+    }
+
+    // The cheapest price of the flight on the day from the city without the entering part.
+    double cheapest_leave(std::size_t day, std::uint16_t from, std::uint16_t & to)
+    {
+        auto best = std::numeric_limits<double>::max();
+        to = from;
+        for_each_next(day, from, [&](std::uint16_t, std::uint16_t next)
+        {
+            auto price = m_costs->get(from, next, static_cast<unsigned int>(day)) - lambda(day, next);
+            if (price < best)
+            {
+                best = price;
+                to = next;
+            }
+        });
+        return best;
+    }
+
+    // The bound for the actual multipliers, the cities entered on each day by
+    // the solution of the relaxation and the ones its leaving parts go to.
+    bool evaluate(double & value, std::vector<std::uint16_t> & entered, std::vector<std::uint16_t> & left)
+    {
+        entered.assign(m_days, 0);
+        left.assign(m_days, 0);
+
+        // The start city and the return to the start area.
+        value = cheapest_leave(0, 0, left[0]);
+
+        auto last = m_days - 1;
+        auto in_start = std::numeric_limits<double>::max();
+        for (auto city : m_start)
+            if (lambda(last, city) < in_start)
+            {
+                in_start = lambda(last, city);
+                entered[last] = city;
+            }
+        value += in_start;
+
+        // The areas at the days between (both 1..n).
+        auto n = m_days - 1;
+        if (n == 0)
+            return true;
+
+        auto inf = std::numeric_limits<double>::max();
+        std::vector<double> weights((n + 1) * (n + 1), inf);
+        std::vector<std::uint16_t> city_at((n + 1) * (n + 1));
+        std::vector<std::uint16_t> next_at((n + 1) * (n + 1));
+        for (std::size_t day = 1; day <= n; ++day)
+        {
+            if (m_interruptible && !g_continue_run)
+                return false;
+
+            for (auto city : m_middle)
+            {
+                std::uint16_t next;
+                auto price = lambda(day - 1, city) + cheapest_leave(day, city, next);
+
+                auto idx = m_area_of[city] * (n + 1) + day;
+                if (price < weights[idx])
+                {
+                    weights[idx] = price;
+                    city_at[idx] = city;
+                    next_at[idx] = next;
+                }
+            }
+        }
+
+        std::vector<std::size_t> area_at;
+        value += assignment(weights, n, area_at);
+
+        for (std::size_t day = 1; day <= n; ++day)
+        {
+            auto idx = area_at[day] * (n + 1) + day;
+            entered[day - 1] = city_at[idx];
+            left[day] = next_at[idx];
+        }
+        return true;
+    }
+
+    // Hungarian method, rows (areas) and columns (days) are 1..n. Returns the
+    // minimal cost and the row assigned to every column.
+    static double assignment(const std::vector<double> & cost, std::size_t n, std::vector<std::size_t> & row_of)
+    {
+        auto inf = std::numeric_limits<double>::max();
+        std::vector<double> u(n + 1), v(n + 1);
+        std::vector<std::size_t> way(n + 1);
+        row_of.assign(n + 1, 0);
+
+        for (std::size_t i = 1; i <= n; ++i)
+        {
+            row_of[0] = i;
+            std::size_t j0 = 0;
+            std::vector<double> minv(n + 1, inf);
+            std::vector<bool> used(n + 1, false);
+            do
+            {
+                used[j0] = true;
+                auto i0 = row_of[j0];
+                auto delta = inf;
+                std::size_t j1 = 0;
+                for (std::size_t j = 1; j <= n; ++j)
+                {
+                    if (used[j])
+                        continue;
+
+                    auto cur = cost[i0 * (n + 1) + j] - u[i0] - v[j];
+                    if (cur < minv[j])
+                    {
+                        minv[j] = cur;
+                        way[j] = j0;
+                    }
+                    if (minv[j] < delta)
+                    {
+                        delta = minv[j];
+                        j1 = j;
+                    }
+                }
+
+                for (std::size_t j = 0; j <= n; ++j)
+                {
+                    if (used[j])
+                    {
+                        u[row_of[j]] += delta;
+                        v[j] -= delta;
+                    }
+                    else
+                        minv[j] -= delta;
+                }
+                j0 = j1;
+            }
+            while (row_of[j0] != 0);
+
+            do
+            {
+                auto j1 = way[j0];
+                row_of[j0] = row_of[j1];
+                j0 = j1;
+            }
+            while (j0);
+        }
+
+        double sum = 0;
+        for (std::size_t j = 1; j <= n; ++j)
+            sum += cost[row_of[j] * (n + 1) + j];
+        return sum;
+    }
+
+    const std::size_t m_days;
+    const std::size_t m_cities;
+
+    // Area of every city, the cities of the start area and of the others.
+    std::vector<int> m_area_of;
+    std::vector<std::uint16_t> m_start;
+    std::vector<std::uint16_t> m_middle;
+
+    // Multipliers, the entering parts of the prices [day, city].
+    std::vector<double> m_lambda;
+    bool m_interruptible = true;
+
+    // A sources of data.
+    const matrix<std::uint16_t> * m_costs;
+};
@@ -0,0 +1,127 @@
+/**
+ * @author Petr Lavicka
+ * @copyright
+ * @file
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Set asynchronously (by a signal) to request a checkpoint as soon as possible.
+extern std::atomic<bool> g_checkpoint_request;
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Binary image of the solver state, native endianity (the checkpoint is meant
+// to be resumed on the same machine or the same kind of machines).
+class checkpoint_t
+{
+public:
+    // Header, identifies the instance the state belongs to.
+    struct header_t
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t areas_count;
+        std::uint32_t cities_count;
+        std::uint64_t fingerprint;
+    };
+
+    static header_t make_header(std::uint32_t areas_count, std::uint32_t cities_count, std::uint64_t fingerprint) noexcept
+    {
+        return header_t{{'K', 'W', 'C', 'P'}, 3, areas_count, cities_count, fingerprint};
+    }
+
+    template <typename T>
+    static void write(std::ostream & out, const T & value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivial types can be saved!");
+        out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    static void write(std::ostream & out, const std::vector<T> & values)
+    {
+        write(out, static_cast<std::uint32_t>(values.size()));
+        out.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+    }
+
+    template <typename T>
+    static bool read(std::istream & in, T & value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivial types can be loaded!");
+        return !!in.read(reinterpret_cast<char *>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    static bool read(std::istream & in, std::vector<T> & values)
+    {
+        std::uint32_t size;
+        if (!read(in, size))
+            return false;
+
+        values.resize(size);
+        return !!in.read(reinterpret_cast<char *>(values.data()), size * sizeof(T));
+    }
+
+    // FNV-1a, used to fingerprint the instance.
+    static std::uint64_t hash(std::uint64_t seed, std::uint64_t value) noexcept
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            seed ^= (value >> (8 * i)) & 0xff;
+            seed *= 1099511628211ull;
+        }
+        return seed;
+    }
+
+    // Writes the file atomically: to a temporary file which then replaces the old one.
+    template <typename Fn>
+    static bool save(const std::string & filename, const header_t & header, Fn && save_state)
+    {
+        auto tmp_filename = filename + ".tmp";
+        {
+            std::ofstream out(tmp_filename, std::ios::binary | std::ios::trunc);
+            write(out, header);
+            save_state(out);
+            if (!out)
+                return false;
+        }
+
+        if (std::rename(tmp_filename.c_str(), filename.c_str()) == 0)
+            return true;
+
+        // Windows doesn't replace an existing file.
+        std::remove(filename.c_str());
+        return std::rename(tmp_filename.c_str(), filename.c_str()) == 0;
+    }
+
+    // Returns false if the file is missing, broken or it belongs to another instance.
+    template <typename Fn>
+    static bool load(const std::string & filename, const header_t & expected, Fn && load_state)
+    {
+        std::ifstream in(filename, std::ios::binary);
+
+        header_t header;
+        if (!read(in, header))
+            return false;
+
+        if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0
+            || header.version != expected.version
+            || header.areas_count != expected.areas_count
+            || header.cities_count != expected.cities_count
+            || header.fingerprint != expected.fingerprint)
+            return false;
+
+        return load_state(in);
+    }
+};
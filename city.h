@@ -8,6 +8,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <ostream>
 #include <unordered_map>
 #include <vector>
 
@@ -71,6 +72,17 @@ public:
 		m_map.reserve(300);
 	}
 
+	// Returns false if the city is not known.
+	bool find_city_index(const city_t & city, std::uint16_t & idx) const
+	{
+		auto it = m_map.find(city);
+		if (it == m_map.end())
+			return false;
+
+		idx = it->second;
+		return true;
+	}
+
 	std::uint16_t get_city_index(const city_t & city)
 	{
 		if (m_map.find(city) != m_map.end())
@@ -95,6 +107,22 @@ public:
 		return m_map.size();
 	}
 
+	// Renumbers the cities by the new indexes, the ones with -1 are removed.
+	void compact(const std::vector<int> & new_index)
+	{
+		for (auto it = m_map.begin(); it != m_map.end();)
+		{
+			if (new_index[it->second] < 0)
+				it = m_map.erase(it);
+			else
+			{
+				it->second = static_cast<std::uint16_t>(new_index[it->second]);
+				++it;
+			}
+		}
+		m_last_idx = static_cast<std::uint16_t>(m_map.size());
+	}
+
 private:
 	std::unordered_map<city_t, std::uint16_t, city_hasher> m_map;
 	std::uint16_t m_last_idx = 0;
@@ -6,98 +6,275 @@
 
 #pragma once
 
-//#include <fstream>
-//#include <string>
-//
-//
-//class config
-//{
-//public:
-//	config()
-//	{
-//		auto fin = std::ifstream("config.txt");
-//
-//		std::string line;
-//		while (std::getline(fin, line))
-//		{
-//			if (strip_prefix(line, "recomp_T="))
-//				recomp_T = std::stoi(line);
-//			else if (strip_prefix(line, "use_swap="))
-//				use_swap = (line != "0");
-//			else if (strip_prefix(line, "use_reverse="))
-//				use_reverse = (line != "0");
-//			else if (strip_prefix(line, "use_insert="))
-//				use_insert = (line != "0");
-//			else if (strip_prefix(line, "max_rev="))
-//				max_rev = std::stoi(line.c_str());
-//			else if (strip_prefix(line, "max_ins="))
-//				max_ins = std::stoi(line.c_str());
-//			else if (strip_prefix(line, "init_T="))
-//				init_T = std::stod(line.c_str());
-//			else if (strip_prefix(line, "last_T="))
-//				last_T = std::stod(line.c_str());
-//			else if (strip_prefix(line, "K="))
-//				K = std::stod(line.c_str());
-//			else if (strip_prefix(line, "iterations="))
-//				iterations = std::stoi(line.c_str());
-//			else if (strip_prefix(line, "seed="))
-//				seed = std::stoi(line.c_str());
-//			else if (strip_prefix(line, "debug="))
-//				debug = (line != "0");
-//		}
-//
-//		if (debug) print();
-//	}
-//
-//	template <typename T>
-//	static bool begins_with(const std::basic_string<T>& str, const T *prefix, size_t length)
-//	{
-//		return str.compare(0, length, prefix, length) == 0;
-//	}
-//
-//	template <typename T>
-//	static bool strip_prefix(std::basic_string<T>& str, const T *prefix)
-//	{
-//		auto length = std::char_traits<T>::length(prefix);
-//		if (begins_with(str, prefix, length))
-//		{
-//			str.erase(0, length);
-//			return true;
-//		}
-//		return false;
-//	}
-//
-//	void print()
-//	{
-//		std::cout << "recomp_T:  " << recomp_T << std::endl;
-////		std::cout << "use_swap:  " << std::boolalpha << use_swap << std::endl;
-////		std::cout << "use_rever: " << std::boolalpha << use_reverse << std::endl;
-////		std::cout << "use_ins:   " << std::boolalpha << use_insert << std::endl;
-//		std::cout << "max_rever: " << max_rev << std::endl;
-//		std::cout << "max_ins:   " << max_ins << std::endl;
-//		std::cout << "init_T:    " << init_T << std::endl;
-//		std::cout << "last_T:    " << last_T << std::endl;
-//		std::cout << "K:         " << K << std::endl;
-//		std::cout << "iterat.:   " << iterations << std::endl;
-////		std::cout << "seed:      " << seed << std::endl;
-//	}
-//
-//	bool debug = false;
-//	int recomp_T = true;
-//
-//	bool use_swap = true;
-//	bool use_reverse = true;
-//	bool use_insert = true;
-//
-//	int max_ins = 1000;
-//	int max_rev = 1000;
-//
-//	double init_T = 0;
-//	double last_T = 0.002;
-//	double K = 0;
-//
-//	int iterations;
-//
-//	int seed = 0;
-//};
-//
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "matrix.h"
+
+
+class config
+{
+public:
+	config() = default;
+
+	// Loads the settings from the file, unknown keys are ignored.
+	bool load(const char * filename)
+	{
+		auto fin = std::ifstream(filename);
+		if (!fin)
+			return false;
+
+		std::string line;
+		while (std::getline(fin, line))
+		{
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+
+			if (strip_prefix(line, "recomp_T="))
+				recomp_T = std::stoi(line);
+			else if (strip_prefix(line, "use_swap="))
+				use_swap = (line != "0");
+			else if (strip_prefix(line, "use_reverse="))
+				use_reverse = (line != "0");
+			else if (strip_prefix(line, "use_insert="))
+				use_insert = (line != "0");
+			else if (strip_prefix(line, "use_segments="))
+				use_segments = (line != "0");
+			else if (strip_prefix(line, "use_reselect="))
+				use_reselect = (line != "0");
+			else if (strip_prefix(line, "max_rev="))
+				max_rev = std::stoi(line.c_str());
+			else if (strip_prefix(line, "max_ins="))
+				max_ins = std::stoi(line.c_str());
+			else if (strip_prefix(line, "init_T="))
+				init_T = std::stod(line.c_str());
+			else if (strip_prefix(line, "last_T="))
+				last_T = std::stod(line.c_str());
+			else if (strip_prefix(line, "K="))
+				K = std::stod(line.c_str());
+			else if (strip_prefix(line, "iterations="))
+				iterations = std::stoi(line.c_str());
+			else if (strip_prefix(line, "seed="))
+				seed = std::stoi(line.c_str());
+			else if (strip_prefix(line, "deterministic="))
+				deterministic = (line != "0");
+			else if (strip_prefix(line, "max_iterations="))
+				max_iterations = std::stoull(line);
+			else if (strip_prefix(line, "debug="))
+				debug = (line != "0");
+			else if (strip_prefix(line, "stream_file="))
+				stream_file = line;
+			else if (strip_prefix(line, "stream_margin="))
+				stream_margin = static_cast<std::uint32_t>(std::stoul(line));
+			else if (strip_prefix(line, "checkpoint_file="))
+				checkpoint_file = line;
+			else if (strip_prefix(line, "checkpoint_period="))
+				checkpoint_period = std::stoi(line);
+			else if (strip_prefix(line, "resume_file="))
+				resume_file = line;
+			else if (strip_prefix(line, "delta_file="))
+				delta_file = line;
+			else if (strip_prefix(line, "warm_T="))
+				warm_T = std::stod(line);
+			else if (strip_prefix(line, "time_limit="))
+				time_limit = std::stoi(line);
+			else if (strip_prefix(line, "max_reheats="))
+				max_reheats = std::stoi(line);
+			else if (strip_prefix(line, "stall_iterations="))
+				stall_iterations = std::stoi(line);
+			else if (strip_prefix(line, "stall_accept="))
+				stall_accept = std::stod(line);
+			else if (strip_prefix(line, "engine_small="))
+				engine_small = line;
+			else if (strip_prefix(line, "engine_medium="))
+				engine_medium = line;
+			else if (strip_prefix(line, "engine_large="))
+				engine_large = line;
+			else if (strip_prefix(line, "tabu_tenure="))
+				tabu_tenure = std::stoi(line);
+			else if (strip_prefix(line, "tabu_max_iterations="))
+				tabu_max_iterations = std::stoull(line);
+			else if (strip_prefix(line, "trace_file="))
+				trace_file = line;
+			else if (strip_prefix(line, "screening="))
+				screening = (line != "0");
+			else if (strip_prefix(line, "preprocess="))
+				preprocess = (line != "0");
+			else if (strip_prefix(line, "lower_bound="))
+				lower_bound = (line != "0");
+			else if (strip_prefix(line, "output_latency="))
+				output_latency = std::stoi(line);
+			else if (strip_prefix(line, "threads="))
+				threads = std::stoi(line);
+			else if (strip_prefix(line, "huge_pages="))
+				huge_pages = static_cast<page_mode_t>(std::stoi(line));
+			else if (strip_prefix(line, "numa_replicas="))
+				numa_replicas = (line != "0");
+			else if (strip_prefix(line, "speculative="))
+				speculative = std::stoi(line);
+			else if (strip_prefix(line, "speculative_batch="))
+				speculative_batch = std::stoi(line);
+		}
+
+		// The warm start needs a temperature of the schedule.
+		if (!(warm_T > 0))
+		{
+			std::cerr << "Ignored warm_T=" << warm_T << ", it must be positive" << std::endl;
+			warm_T = config().warm_T;
+		}
+
+		if (debug) print();
+		return true;
+	}
+
+	template <typename T>
+	static bool begins_with(const std::basic_string<T>& str, const T *prefix, size_t length)
+	{
+		return str.compare(0, length, prefix, length) == 0;
+	}
+
+	template <typename T>
+	static bool strip_prefix(std::basic_string<T>& str, const T *prefix)
+	{
+		auto length = std::char_traits<T>::length(prefix);
+		if (begins_with(str, prefix, length))
+		{
+			str.erase(0, length);
+			return true;
+		}
+		return false;
+	}
+
+	// Prints to stderr, stdout is reserved for the result.
+	void print()
+	{
+		std::cerr << "recomp_T:  " << recomp_T << std::endl;
+		std::cerr << "use_swap:  " << std::boolalpha << use_swap << std::endl;
+		std::cerr << "use_rever: " << std::boolalpha << use_reverse << std::endl;
+		std::cerr << "use_ins:   " << std::boolalpha << use_insert << std::endl;
+		std::cerr << "use_segm.: " << std::boolalpha << use_segments << std::endl;
+		std::cerr << "use_resel: " << std::boolalpha << use_reselect << std::endl;
+		std::cerr << "max_rever: " << max_rev << std::endl;
+		std::cerr << "max_ins:   " << max_ins << std::endl;
+		std::cerr << "init_T:    " << init_T << std::endl;
+		std::cerr << "last_T:    " << last_T << std::endl;
+		std::cerr << "K:         " << K << std::endl;
+		std::cerr << "iterat.:   " << iterations << std::endl;
+		std::cerr << "seed:      " << seed << " (deterministic " << std::boolalpha << deterministic << ", max. iterations " << max_iterations << ")" << std::endl;
+		std::cerr << "stream:    " << stream_file << " (margin " << stream_margin << ")" << std::endl;
+		std::cerr << "checkp.:   " << checkpoint_file << " (period " << checkpoint_period << " ms)" << std::endl;
+		std::cerr << "resume:    " << resume_file << std::endl;
+		std::cerr << "delta:     " << delta_file << " (warm_T " << warm_T << ")" << std::endl;
+		std::cerr << "reheats:   " << max_reheats << " (stall " << stall_iterations << " iterations, acceptance " << stall_accept << ")" << std::endl;
+		std::cerr << "engines:   " << engine_small << ", " << engine_medium << ", " << engine_large << " (tabu tenure " << tabu_tenure << ", max. iterations " << tabu_max_iterations << ")" << std::endl;
+		std::cerr << "trace:     " << trace_file << std::endl;
+		std::cerr << "screening: " << std::boolalpha << screening << std::endl;
+		std::cerr << "preproc.:  " << std::boolalpha << preprocess << std::endl;
+		std::cerr << "low_bound: " << std::boolalpha << lower_bound << std::endl;
+		std::cerr << "time:      " << time_limit << " ms (output latency " << output_latency << " ms)" << std::endl;
+		std::cerr << "threads:   " << threads << std::endl;
+		std::cerr << "huge_p.:   " << static_cast<int>(huge_pages) << std::endl;
+		std::cerr << "numa_rep.: " << std::boolalpha << numa_replicas << std::endl;
+		std::cerr << "specul.:   " << speculative << " (batch " << speculative_batch << ")" << std::endl;
+	}
+
+	bool debug = false;
+	int recomp_T = 512;
+
+	bool use_swap = true;
+	bool use_reverse = true;
+	bool use_insert = true;
+
+	// Compound operators (only together with all the ones above).
+	bool use_segments = false;
+	bool use_reselect = false;
+
+	int max_ins = 30;
+	int max_rev = 30;
+
+	double init_T = 0;
+	double last_T = 0.002;
+	double K = 0;
+
+	int iterations = 0;
+
+	int seed = 0;
+
+	// All the random generators start from the seed (the chains from the
+	// seed and their index) and the run stops after the iterations of every
+	// chain (0 = no limit) instead of the time limit, unless it is given.
+	bool deterministic = false;
+	std::uint64_t max_iterations = 0;
+
+	// Anytime output, empty file name turns it off.
+	std::string stream_file;
+	std::uint32_t stream_margin = 0;
+
+	// Checkpoints of the solver state, the period is in ms (0 = only on
+	// a signal and at the end). Empty file names turn it off.
+	std::string checkpoint_file;
+	int checkpoint_period = 0;
+	std::string resume_file;
+
+	// Price updates applied after the input, a run resumed with them starts
+	// from the best path of the checkpoint at the temperature warm_T.
+	std::string delta_file;
+	double warm_T = 0.01;
+
+	// Reheats of a stagnating annealing chain (0 = off), the iterations
+	// without a better path (0 = by the size) and the acceptance ratio below
+	// which the chain stagnates.
+	int max_reheats = 0;
+	int stall_iterations = 0;
+	double stall_accept = 0.02;
+
+	// Search engine (anneal or tabu) by the size tier of the instance, the
+	// tabu tenure in iterations (0 = by the size) and the iterations of every
+	// tabu chain (0 = no limit). A tabu iteration prices the whole
+	// neighbourhood, so the max_iterations above count the annealing only.
+	std::string engine_small = "anneal";
+	std::string engine_medium = "anneal";
+	std::string engine_large = "anneal";
+	int tabu_tenure = 0;
+	std::uint64_t tabu_max_iterations = 0;
+
+	// Chrome trace of the phases of the run, empty file name turns it off.
+	std::string trace_file;
+
+	// The annealing screens the proposals (of all the operators, the compound
+	// ones too) by the prices quantized to 8 bits and prices exactly only the
+	// ones which may be accepted.
+	bool screening = false;
+
+	// Removal of the unreachable and dominated cities after the input (and
+	// the fare updates), the matrix is shrunk to the rest. Off by default.
+	bool preprocess = false;
+
+	// Lower bound of the cost computed by a spare thread, the run stops when
+	// the best path reaches it. Off by default, the thread takes a core. In
+	// the deterministic mode it has up to 20 rounds regardless of the time
+	// limit, so it is the same in every run.
+	bool lower_bound = false;
+
+	// Time limit in ms, 0 = by the size of the instance (a fifth of it for
+	// a warm start).
+	int time_limit = 0;
+
+	// The longest time in ms from the stop (the time limit or a signal) to
+	// the output, then the last snapshot of the best path is printed.
+	int output_latency = 40;
+
+	// Independent annealing chains (0 = one per hardware thread), the best
+	// result wins. With numa_replicas every NUMA node gets its own copy of
+	// the prices and the chains are pinned to the nodes.
+	int threads = 1;
+	page_mode_t huge_pages = page_mode_t::normal;
+	bool numa_replicas = false;
+
+	// Helper threads evaluating proposals of a chain ahead (0 = off) and
+	// the number of proposals evaluated at once.
+	int speculative = 0;
+	int speculative_batch = 64;
+};
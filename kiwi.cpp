@@ -5,6 +5,7 @@
  */
 
 #include <atomic>
+#include <iomanip>
 #include <cctype>
 #include <chrono>
 #include <cmath>
@@ -12,39 +13,109 @@
 #include <cstdint>
 #include <cstdio>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "anneal.h"
+#include "bound.h"
+#include "checkpoint.h"
 #include "city.h"
 #include "config.h"
 #include "matrix.h"
+#include "numa.h"
 #include "parser.h"
 #include "path.h"
+#include "preprocess.h"
 #include "random.h"
+#include "screen.h"
+#include "solver.h"
+#include "stream.h"
+#include "tabu.h"
+#include "trace.h"
+#include "watchdog.h"
 
 // Start of the program
 static const auto g_start_time = std::chrono::high_resolution_clock::now();
 std::atomic<bool> g_continue_run(true);
+std::atomic<bool> g_checkpoint_request(false);
+std::atomic<bool> g_dump_request(false);
+trace_t g_trace(g_start_time);
 
-static std::thread set_time_limit(std::size_t cities_count, std::size_t areas_count)
+// Size tiers of the instances (as the time limits are given).
+enum size_tier_t
 {
-    using namespace std::chrono_literals;
+    SMALL_TIER,
+    MEDIUM_TIER,
+    LARGE_TIER,
+};
 
-    auto time = 15s;
+static size_tier_t get_size_tier(std::size_t cities_count, std::size_t areas_count)
+{
     if (areas_count <= 20 && cities_count < 50)
-        time = 3s;
-    else if (areas_count <= 100 && cities_count < 200)
-        time = 5s;
+        return SMALL_TIER;
+    if (areas_count <= 100 && cities_count < 200)
+        return MEDIUM_TIER;
+    return LARGE_TIER;
+}
+
+// Tier of the input (the preprocessing doesn't change it).
+static size_tier_t g_size_tier = LARGE_TIER;
+
+// Search engine of the input (by its tier).
+static engine_t g_engine = engine_t::annealing;
+
+// The search stops at the returned time (the rest is left for the output).
+static std::chrono::high_resolution_clock::time_point get_deadline()
+{
+    using namespace std::chrono_literals;
+
+    // A deterministic run stops by the iterations (of its engine) only.
+    auto max_iterations = (g_engine == engine_t::tabu) ? g_config.tabu_max_iterations : g_config.max_iterations;
+    if (g_config.deterministic && max_iterations && !g_config.time_limit)
+        return std::chrono::high_resolution_clock::time_point::max();
 
-    auto elapsed_time = std::chrono::high_resolution_clock::now() - g_start_time;
-    return std::thread([=]{ std::this_thread::sleep_for(time - elapsed_time - 50ms); g_continue_run = false; });
+    std::chrono::milliseconds time = 15s;
+    switch (g_size_tier)
+    {
+    case SMALL_TIER:  time = 3s; break;
+    case MEDIUM_TIER: time = 5s; break;
+    default:          break;
+    }
+
+    if (g_config.time_limit)
+        time = std::chrono::milliseconds(g_config.time_limit);
+    else if (!g_config.delta_file.empty() && !g_config.resume_file.empty())
+        time /= 5;
+
+    return g_start_time + time - 50ms;
 }
 
 
- //// Global config data.
- //config g_config;
+// Global config data.
+config g_config;
+
+#ifdef SIGUSR2
+static void request_checkpoint(int)
+{
+    g_checkpoint_request = true;
+}
+#endif
+
+// SIGTERM, SIGINT: stop and print the best path found so far.
+static void request_stop(int)
+{
+    g_continue_run = false;
+}
+
+#ifdef SIGUSR1
+static void request_dump(int)
+{
+    g_dump_request = true;
+}
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -78,6 +149,7 @@ static std::vector<std::uint16_t> cities_names_to_cities_idx(const char * city_n
 
 static void parse_input_data(cities_map_t & cities_indexer, std::vector<area_t> & areas_list, matrix<std::uint16_t> & costs_matrix)
 {
+    trace_scope_t trace("parse");
     parser_t parser;
 
     // Read number of locations and start city.
@@ -109,12 +181,23 @@ static void parse_input_data(cities_map_t & cities_indexer, std::vector<area_t>
             areas_list.push_back(area_t(/*std::move(area_name),*/ std::move(cities)));
     }
 
-    // Save all flights to the matrix.
-    costs_matrix.set_dim(static_cast<unsigned int>(cities_indexer.count()));
+    {
+        trace_scope_t set_dim_trace("set_dim");
+        costs_matrix.set_dim(static_cast<unsigned int>(cities_indexer.count()), g_config.huge_pages);
+    }
+
+    // Save all flights to the matrix. The expansions of the wildcard days are
+    // only summed up in the trace, they are too many for the events.
+    trace_scope_t flights_trace("flights");
+    std::size_t flights = 0, wildcards = 0;
+    trace_t::clock_t::duration wildcards_time{0};
+
     char * from, * to;
     std::uint16_t day, price;
     while (parser.parse_line(from, to, day, price))
     {
+        ++flights;
+
         auto idx_src = cities_indexer.get_city_index(city_t(from));
         auto idx_dst = cities_indexer.get_city_index(city_t(to));
 
@@ -122,18 +205,275 @@ static void parse_input_data(cities_map_t & cities_indexer, std::vector<area_t>
             costs_matrix.set(idx_src, idx_dst, day - 1, price);
         else
         {
+            auto begin = g_trace.enabled() ? trace_t::clock_t::now() : trace_t::clock_t::time_point();
+
             auto count = cities_indexer.count();
             for (std::uint16_t j = 0; j < count; ++j)
                 costs_matrix.set(idx_src, idx_dst, j, price);
+
+            ++wildcards;
+            if (g_trace.enabled())
+                wildcards_time += trace_t::clock_t::now() - begin;
         }
     }
+
+    flights_trace.arg("flights", static_cast<double>(flights));
+    flights_trace.arg("wildcards", static_cast<double>(wildcards));
+    flights_trace.arg("wildcards_ms", std::chrono::duration<double, std::milli>(wildcards_time).count());
+}
+
+// Applies the price updates (lines as the flights in the input) to the loaded matrix.
+static bool apply_fare_updates(const char * filename, const cities_map_t & cities_indexer, matrix<std::uint16_t> & costs_matrix)
+{
+    trace_scope_t trace("fare updates");
+
+    auto file = std::fopen(filename, "r");
+    if (!file)
+        return false;
+
+    parser_t parser(file);
+
+    std::size_t count = 0, skipped = 0;
+    char * from, * to;
+    std::uint16_t day, price;
+    while (parser.parse_line(from, to, day, price))
+    {
+        // There is no room for new cities in the matrix.
+        std::uint16_t idx_src, idx_dst;
+        if (!cities_indexer.find_city_index(city_t(from), idx_src) || !cities_indexer.find_city_index(city_t(to), idx_dst))
+        {
+            ++skipped;
+            continue;
+        }
+
+        if (day)
+            costs_matrix.update(idx_src, idx_dst, day - 1, price);
+        else
+        {
+            auto count = cities_indexer.count();
+            for (std::uint16_t j = 0; j < count; ++j)
+                costs_matrix.update(idx_src, idx_dst, j, price);
+        }
+        ++count;
+    }
+    std::fclose(file);
+
+    // The updates may have lowered the maximal price (the scale of the acceptance).
+    costs_matrix.update_max();
+
+    if (g_config.debug)
+        std::cerr << "fare updates: " << count << " applied, " << skipped << " with unknown cities" << std::endl;
+    return true;
+}
+
+// Removes the cities no optimal path needs and shrinks the matrix to the rest.
+static void preprocess(std::vector<area_t> & areas_list, cities_map_t & cities_indexer, matrix<std::uint16_t> & costs_matrix)
+{
+    trace_scope_t trace("preprocess");
+
+    area_pruning_t pruning(areas_list, &costs_matrix);
+    pruning.run();
+
+    if (g_config.debug)
+    {
+        for (auto city : pruning.unreachable())
+            std::cerr << "unreachable: " << cities_indexer.get_city_object(city) << std::endl;
+        for (auto city : pruning.dominated())
+            std::cerr << "dominated:   " << cities_indexer.get_city_object(city) << std::endl;
+    }
+
+    auto dropped = compact_cities(areas_list, cities_indexer, costs_matrix, g_config.huge_pages);
+    if (g_config.debug)
+        std::cerr << "preprocessing: " << pruning.unreachable().size() << " unreachable and " << pruning.dominated().size()
+                  << " dominated cities removed, " << dropped << " dropped from the prices, " << cities_indexer.count() << " left" << std::endl;
+}
+
+// The search engine for the instance by its size tier.
+static engine_t get_engine()
+{
+    const std::string * names[] = {&g_config.engine_small, &g_config.engine_medium, &g_config.engine_large};
+    const auto & name = *names[g_size_tier];
+
+    engine_t engine = engine_t::annealing;
+    if (!parse_engine(name, engine))
+        std::cerr << "Unknown engine: " << name << std::endl;
+
+    // The checkpoints and the speculative evaluation need the annealing.
+    if (engine != engine_t::annealing && (!g_config.checkpoint_file.empty() || !g_config.resume_file.empty() || g_config.speculative > 0))
+    {
+        if (g_config.debug)
+            std::cerr << "engine: " << name << " replaced by anneal for the checkpoints or the speculative evaluation" << std::endl;
+        engine = engine_t::annealing;
+    }
+    return engine;
+}
+
+template <typename Path>
+static solver_stats_t run_engine(engine_t engine, Path & path, const solver_context_t & context)
+{
+    trace_scope_t trace("search");
+    trace.arg("chain", context.chain);
+
+    switch (engine)
+    {
+    case engine_t::tabu: return tabu_search_t<Path>().run(path, context);
+    default:             return annealing_t<Path>().run(path, context);
+    }
+}
+
+// Runs independent chains in parallel and keeps the best path.
+template <typename Path>
+static solver_stats_t optimize_parallel(Path & path, int threads, const matrix<std::uint16_t> & costs_matrix, engine_t engine, solver_context_t context)
+{
+    numa_topology_t topology;
+
+    // Read only copies of the prices, one per node.
+    std::vector<std::unique_ptr<matrix<std::uint16_t>>> replicas;
+    if (g_config.numa_replicas && topology.nodes() > 1)
+        replicas = topology.replicate(costs_matrix, g_config.huge_pages);
+
+    std::vector<Path> paths(threads, path);
+    std::vector<solver_stats_t> stats(threads);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.emplace_back([&, i]
+        {
+            if (g_trace.enabled())
+                g_trace.name_thread("chain " + std::to_string(i));
+
+            auto node = i % topology.nodes();
+            if (!replicas.empty())
+            {
+                topology.pin_thread(node);
+                paths[i].use_costs(replicas[node].get());
+            }
+
+            auto chain_context = context;
+            chain_context.chain = i;
+            stats[i] = run_engine(engine, paths[i], chain_context);
+            paths[i].use_costs(&costs_matrix);
+        });
+    }
+
+    for (auto & worker : workers)
+        worker.join();
+
+    path = *std::min_element(paths.begin(), paths.end(), [](const Path & a, const Path & b) { return a.cost() < b.cost(); });
+
+    solver_stats_t total;
+    for (const auto & chain : stats)
+    {
+        total.iterations += chain.iterations;
+        for (int m = 0; m < METHODS_COUNT; ++m)
+            total.accepted[m] += chain.accepted[m];
+    }
+    return total;
+}
+
+// Optimizes and prints the path of the given specialization, returns its cost.
+template <typename Index, unsigned Ops>
+static std::uint32_t solve(const std::vector<area_t> & areas_list, const cities_map_t & cities_indexer, const matrix<std::uint16_t> & costs_matrix, const solver_context_t & context, watchdog_t & watchdog)
+{
+    // Generate a random path.
+    auto path = [&]
+    {
+        trace_scope_t trace("path constructor");
+        return areapath_t<Index, Ops>(areas_list, &cities_indexer, &costs_matrix, static_cast<std::uint64_t>(g_config.seed));
+    }();
+
+    // Print the optimized path and the cost.
+    auto engine = g_engine;
+    auto threads = g_config.threads ? g_config.threads : static_cast<int>(std::thread::hardware_concurrency());
+    auto search_start = std::chrono::high_resolution_clock::now();
+    auto stats = (threads > 1) ? optimize_parallel(path, threads, costs_matrix, engine, context)
+                               : run_engine(engine, path, context);
+    std::chrono::duration<double> search_time = std::chrono::high_resolution_clock::now() - search_start;
+
+    auto output_lock = watchdog.claim_output();
+    {
+        trace_scope_t trace("print");
+        path.print(std::cout);
+    }
+
+    // Summary for the comparison of the engines and of the builds (on the same trajectory in the deterministic mode).
+    static const char * tiers[] = {"small", "medium", "large"};
+    std::cerr << "tier " << tiers[g_size_tier] << ", engine " << engine_name(engine)
+              << ", iterations " << stats.iterations << " (" << static_cast<std::uint64_t>(stats.iterations / std::max(search_time.count(), 1e-6)) << " / s)"
+              << ", cost " << path.cost();
+    if (g_config.deterministic)
+        std::cerr << ", seed " << g_config.seed;
+    std::cerr << std::endl;
+
+    return path.cost();
+}
+
+// Chooses the specialization by the operators from the config.
+template <typename Index>
+static std::uint32_t solve(const std::vector<area_t> & areas_list, const cities_map_t & cities_indexer, const matrix<std::uint16_t> & costs_matrix, const solver_context_t & context, watchdog_t & watchdog)
+{
+    auto ops = (g_config.use_swap ? USE_SWAP : 0u) | (g_config.use_reverse ? USE_REVERSE : 0u) | (g_config.use_insert ? USE_INSERT : 0u);
+
+    // The compound operators are specialized only on top of all the basic ones (the count of the specializations).
+    auto compound = (g_config.use_segments ? USE_SEGMENTS : 0u) | (g_config.use_reselect ? USE_RESELECT : 0u);
+    if (compound && ops != USE_ALL)
+        std::cerr << "The compound operators need all the basic ones, not used." << std::endl;
+    else
+        ops |= compound;
+
+    switch (ops)
+    {
+    case 0: return solve<Index, 0>(areas_list, cities_indexer, costs_matrix, context, watchdog);
+    case USE_SWAP: return solve<Index, USE_SWAP>(areas_list, cities_indexer, costs_matrix, context, watchdog);
+    case USE_REVERSE: return solve<Index, USE_REVERSE>(areas_list, cities_indexer, costs_matrix, context, watchdog);
+    case USE_INSERT: return solve<Index, USE_INSERT>(areas_list, cities_indexer, costs_matrix, context, watchdog);
+    case USE_SWAP | USE_REVERSE: return solve<Index, USE_SWAP | USE_REVERSE>(areas_list, cities_indexer, costs_matrix, context, watchdog);
+    case USE_SWAP | USE_INSERT: return solve<Index, USE_SWAP | USE_INSERT>(areas_list, cities_indexer, costs_matrix, context, watchdog);
+    case USE_REVERSE | USE_INSERT: return solve<Index, USE_REVERSE | USE_INSERT>(areas_list, cities_indexer, costs_matrix, context, watchdog);
+    case USE_ALL | USE_SEGMENTS: return solve<Index, USE_ALL | USE_SEGMENTS>(areas_list, cities_indexer, costs_matrix, context, watchdog);
+    case USE_ALL | USE_RESELECT: return solve<Index, USE_ALL | USE_RESELECT>(areas_list, cities_indexer, costs_matrix, context, watchdog);
+    case USE_ALL | USE_SEGMENTS | USE_RESELECT: return solve<Index, USE_ALL | USE_SEGMENTS | USE_RESELECT>(areas_list, cities_indexer, costs_matrix, context, watchdog);
+    default: return solve<Index, USE_ALL>(areas_list, cities_indexer, costs_matrix, context, watchdog);
+    }
+}
+
+// Chooses the specialization by the size of the instance (main() checks it fits).
+static std::uint32_t solve(const std::vector<area_t> & areas_list, const cities_map_t & cities_indexer, const matrix<std::uint16_t> & costs_matrix, const solver_context_t & context, watchdog_t & watchdog)
+{
+    if (areapath_t<std::uint8_t>::fits(cities_indexer.count(), areas_list.size()))
+        return solve<std::uint8_t>(areas_list, cities_indexer, costs_matrix, context, watchdog);
+    else
+        return solve<std::uint16_t>(areas_list, cities_indexer, costs_matrix, context, watchdog);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
-int main()
+int main(int argc, char * argv[])
 {
+    // The only optional argument is the config file.
+    if (argc > 1 && !g_config.load(argv[1]))
+        std::cerr << "Cannot read the config file: " << argv[1] << std::endl;
+
+    if (!g_config.trace_file.empty())
+    {
+        g_trace.enable();
+        g_trace.name_thread("main");
+    }
+
+#ifdef SIGUSR2
+    // Save the solver state on demand.
+    if (!g_config.checkpoint_file.empty())
+        std::signal(SIGUSR2, request_checkpoint);
+#endif
+
+    // Stop early (with the output) or dump the best path on demand.
+    std::signal(SIGTERM, request_stop);
+    std::signal(SIGINT, request_stop);
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, request_dump);
+#endif
+
     // Create the holders of cities and areas [name <-> index] and price matrix.
     cities_map_t cities_indexer;
     std::vector<area_t> areas_list;
@@ -141,16 +481,93 @@ int main()
 
     parse_input_data(cities_indexer, areas_list, costs_matrix);
 
-    // Set timer to the end.
-    auto timeout = set_time_limit(cities_indexer.count(), areas_list.size());
+    if (!g_config.delta_file.empty() && !apply_fare_updates(g_config.delta_file.c_str(), cities_indexer, costs_matrix))
+        std::cerr << "Cannot read the fare updates: " << g_config.delta_file << std::endl;
 
-    // Generate a random path.
-    areapath_t path(std::move(areas_list), &cities_indexer, &costs_matrix);
+    g_size_tier = get_size_tier(cities_indexer.count(), areas_list.size());
+    g_engine = get_engine();
+    if (g_config.preprocess)
+        preprocess(areas_list, cities_indexer, costs_matrix);
 
-    // Print the optimized path and the cost.
-    path.optimize();
-    path.print(std::cout);
+    // The paths index the cities and the days by 16 bits at most, there is no result to print.
+    if (!areapath_t<std::uint16_t>::fits(cities_indexer.count(), areas_list.size()))
+    {
+        std::cerr << "Too many cities or areas: " << cities_indexer.count() << ", " << areas_list.size() << std::endl;
+        return 1;
+    }
+
+    // Quantized prices for the screening of the proposals.
+    screen_matrix_t screen;
+    if (g_config.screening)
+    {
+        trace_scope_t trace("screening matrix");
+        screen.build(costs_matrix, g_config.huge_pages);
+    }
+
+    // Set timer to the end, the watchdog prints the best path in time if the program doesn't.
+    watchdog_t watchdog(get_deadline(), std::chrono::milliseconds(g_config.output_latency),
+                        &cities_indexer, &costs_matrix);
+
+    // Anytime output of improving solutions.
+    std::unique_ptr<solution_stream_t> stream;
+    if (!g_config.stream_file.empty())
+        stream = std::make_unique<solution_stream_t>(g_config.stream_file, g_config.stream_margin, g_start_time, &cities_indexer, &costs_matrix);
+
+    // How far from the optimum the paths are. In the deterministic mode the
+    // bound has a fixed number of rounds which the stop doesn't cut.
+    const unsigned int deterministic_rounds = 20;
+    lower_bound_t bound(areas_list, cities_indexer.count(), &costs_matrix);
+    std::atomic<std::uint32_t> best_bound(0);
+    std::thread bound_thread;
+    if (g_config.lower_bound)
+    {
+        bound_thread = std::thread([&]
+        {
+            if (g_trace.enabled())
+                g_trace.name_thread("lower bound");
+            trace_scope_t trace("lower bound");
+
+            bound.run([&](std::uint32_t value)
+            {
+                best_bound = value;
+                // The early stop would depend on the timing of the threads.
+                if (!g_config.deterministic)
+                    watchdog.set_lower_bound(value);
+                if (stream)
+                    stream->set_lower_bound(value);
+            },
+            [&]
+            {
+                // The steps mustn't depend on the paths found so far either.
+                if (g_config.deterministic)
+                    return std::numeric_limits<std::uint32_t>::max();
+                return watchdog.snapshot().cost();
+            },
+            g_config.deterministic ? deterministic_rounds : 1000, !g_config.deterministic);
+        });
+    }
+
+    solver_context_t context;
+    context.stream = stream.get();
+    context.snapshot = &watchdog.snapshot();
+    if (g_config.screening)
+        context.screen = &screen;
+
+    auto cost = solve(areas_list, cities_indexer, costs_matrix, context, watchdog);
+
+    // The search may end by the iterations, the rest stops too.
+    g_continue_run = false;
+
+    if (g_config.lower_bound)
+    {
+        bound_thread.join();
+
+        // The gap of the printed path (the snapshot may be older).
+        std::cerr << "cost " << cost << ", lower bound " << best_bound << ", gap "
+                  << std::fixed << std::setprecision(2) << gap_percent(cost, best_bound) << " %" << std::endl;
+    }
 
-    timeout.join();
+    if (g_trace.enabled() && !g_trace.write(g_config.trace_file))
+        std::cerr << "Cannot write the trace: " << g_config.trace_file << std::endl;
     return 0;
 }
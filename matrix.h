@@ -6,11 +6,25 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <limits>
 #include <memory>
 
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+
+// How the memory of the matrix is backed (huge pages cut the TLB misses).
+enum class page_mode_t
+{
+	normal,      // new[]
+	transparent, // anonymous mapping advised to use transparent huge pages
+	huge,        // explicit huge pages (hugetlbfs), transparent ones if there are none
+};
+
 
 template <typename T>
 class matrix
@@ -24,6 +38,7 @@ public:
     }
 
 	matrix(unsigned int dim)
+        : matrix()
 	{
         set_dim(dim);
 	}
@@ -33,47 +48,174 @@ public:
 
 	~matrix()
 	{
-		delete[] m_matrix;
+		release();
 	}
 
-    void set_dim(unsigned int dim)
+    void set_dim(unsigned int dim, page_mode_t pages = page_mode_t::normal)
     {
-        auto length = dim * dim * dim;
-        assert(length < std::numeric_limits<decltype(m_dim)>::max());
+        auto length = static_cast<std::size_t>(dim) * dim * dim;
 
+        allocate(length, pages);
         m_dim = dim;
-        m_matrix = new T[length];
         m_max_val = std::numeric_limits<T>::min();
 
         std::fill_n(m_matrix, length, std::numeric_limits<T>::max());
     }
 
+	// Makes a copy of the other matrix. The memory is touched first by the calling
+	// thread, so it is placed on the NUMA node the thread runs on.
+	void copy_from(const matrix<T> & other, page_mode_t pages = page_mode_t::normal)
+	{
+		auto length = static_cast<std::size_t>(other.m_dim) * other.m_dim * other.m_dim;
+
+		allocate(length, pages);
+		m_dim = other.m_dim;
+		m_max_val = other.m_max_val;
+
+		std::copy_n(other.m_matrix, length, m_matrix);
+	}
+
+	// Uses the external data (not copied nor released), the maximum is computed
+	// from the prices (the maximal value of T means there is no flight).
+	void attach(T * data, unsigned int dim) noexcept
+	{
+		release();
+		m_dim = dim;
+		m_matrix = data;
+		m_attached = true;
+
+		update_max();
+	}
+
+	// Computes the maximum from the prices again (after the update()s, which
+	// only raise it).
+	void update_max() noexcept
+	{
+		auto length = static_cast<std::size_t>(m_dim) * m_dim * m_dim;
+		m_max_val = std::numeric_limits<T>::min();
+		for (std::size_t i = 0; i < length; ++i)
+			if (m_matrix[i] > m_max_val && m_matrix[i] != std::numeric_limits<T>::max())
+				m_max_val = m_matrix[i];
+	}
+
 	T get_max() const noexcept
 	{
 		return m_max_val;
 	}
 
-	std::int32_t get(std::uint16_t x, std::uint16_t y, std::uint16_t z) const noexcept
+	std::int32_t get(unsigned int x, unsigned int y, unsigned int z) const noexcept
 	{
         assert(x < m_dim);
         assert(y < m_dim);
         assert(z < m_dim);
-		return m_matrix[(x * m_dim * m_dim) + (y * m_dim) + (z)];
+		return m_matrix[offset(x, y, z)];
 	}
 
-	void set(std::uint16_t x, std::uint16_t y, std::uint16_t z, T value) noexcept
+	void set(unsigned int x, unsigned int y, unsigned int z, T value) noexcept
 	{
         if (value < get(x, y, z))
         {
-		    m_matrix[(x * m_dim * m_dim) + (y * m_dim) + (z)] = value;
+		    m_matrix[offset(x, y, z)] = value;
 
 		    if (value > m_max_val)
 			    m_max_val = value;
         }
 	}
 
+	// Unlike set() the value replaces the old one (a changed price, the maximal
+	// value of T removes the flight). A lowered maximum needs update_max().
+	void update(unsigned int x, unsigned int y, unsigned int z, T value) noexcept
+	{
+		m_matrix[offset(x, y, z)] = value;
+
+		if (value > m_max_val && value != std::numeric_limits<T>::max())
+			m_max_val = value;
+	}
+
+	unsigned int dim() const noexcept
+	{
+		return m_dim;
+	}
+
+	void swap(matrix<T> & other) noexcept
+	{
+		std::swap(m_dim, other.m_dim);
+		std::swap(m_matrix, other.m_matrix);
+		std::swap(m_max_val, other.m_max_val);
+		std::swap(m_mapped_bytes, other.m_mapped_bytes);
+		std::swap(m_attached, other.m_attached);
+	}
+
 private:
+	// In size_t, the count of the items overflows 32 bits for about 1600 cities.
+	std::size_t offset(unsigned int x, unsigned int y, unsigned int z) const noexcept
+	{
+		return (x * static_cast<std::size_t>(m_dim) + y) * m_dim + z;
+	}
+
+	void allocate(std::size_t length, page_mode_t pages)
+	{
+		release();
+
+#ifdef __linux__
+		if (pages != page_mode_t::normal)
+		{
+			// Whole 2 MB pages.
+			const std::size_t huge_page = 2 * 1024 * 1024;
+			auto bytes = (length * sizeof(T) + huge_page - 1) / huge_page * huge_page;
+
+			void * ptr = MAP_FAILED;
+			if (pages == page_mode_t::huge)
+				ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+			if (ptr == MAP_FAILED)
+			{
+				ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (ptr != MAP_FAILED)
+					madvise(ptr, bytes, MADV_HUGEPAGE);
+			}
+
+			if (ptr != MAP_FAILED)
+			{
+				m_matrix = static_cast<T *>(ptr);
+				m_mapped_bytes = bytes;
+				return;
+			}
+		}
+#endif
+
+		m_matrix = new T[length];
+	}
+
+	void release() noexcept
+	{
+		if (m_attached)
+		{
+			m_attached = false;
+			m_matrix = nullptr;
+			return;
+		}
+
+#ifdef __linux__
+		if (m_mapped_bytes)
+		{
+			munmap(m_matrix, m_mapped_bytes);
+			m_mapped_bytes = 0;
+			m_matrix = nullptr;
+			return;
+		}
+#endif
+
+		delete[] m_matrix;
+		m_matrix = nullptr;
+	}
+
 	unsigned int m_dim;
 	T * m_matrix;
 	T   m_max_val;
+
+	// Size of the mapping, 0 if the memory is allocated by new[].
+	std::size_t m_mapped_bytes = 0;
+	// The memory belongs to someone else.
+	bool m_attached = false;
 };
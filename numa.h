@@ -0,0 +1,120 @@
+/**
+ * @author Petr Lavicka
+ * @copyright
+ * @file
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "matrix.h"
+
+
+// NUMA nodes and their CPUs (read from sysfs, no libnuma needed). Without
+// the information there is one node and threads are not pinned at all.
+class numa_topology_t
+{
+public:
+    numa_topology_t()
+    {
+#ifdef __linux__
+        for (int node = 0; ; ++node)
+        {
+            std::ifstream fin("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string list;
+            if (!fin || !std::getline(fin, list))
+                break;
+
+            auto cpus = parse_cpulist(list);
+            if (!cpus.empty())
+                m_nodes.push_back(std::move(cpus));
+        }
+#endif
+
+        if (m_nodes.empty())
+            m_nodes.push_back(std::vector<int>());
+    }
+
+    std::size_t nodes() const noexcept
+    {
+        return m_nodes.size();
+    }
+
+    // Pins the calling thread to the CPUs of the node.
+    bool pin_thread(std::size_t node) const
+    {
+#ifdef __linux__
+        const auto & cpus = m_nodes[node % m_nodes.size()];
+        if (cpus.empty())
+            return false;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto cpu : cpus)
+            CPU_SET(cpu, &set);
+
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+        (void)node;
+        return false;
+#endif
+    }
+
+    // One copy of the matrix per node, each one filled by a thread pinned to
+    // its node (the first touch places the pages there).
+    template <typename T>
+    std::vector<std::unique_ptr<matrix<T>>> replicate(const matrix<T> & original, page_mode_t pages) const
+    {
+        std::vector<std::unique_ptr<matrix<T>>> replicas(m_nodes.size());
+
+        std::vector<std::thread> threads;
+        for (std::size_t node = 0; node < m_nodes.size(); ++node)
+        {
+            threads.emplace_back([&, node]
+            {
+                pin_thread(node);
+                replicas[node] = std::make_unique<matrix<T>>();
+                replicas[node]->copy_from(original, pages);
+            });
+        }
+
+        for (auto & thread : threads)
+            thread.join();
+        return replicas;
+    }
+
+private:
+    // Format: "0-3,8-11"
+    static std::vector<int> parse_cpulist(const std::string & list)
+    {
+        std::vector<int> cpus;
+
+        std::istringstream sin(list);
+        std::string range;
+        while (std::getline(sin, range, ','))
+        {
+            if (range.empty())
+                continue;
+
+            auto dash = range.find('-');
+            auto first = std::stoi(range.substr(0, dash));
+            auto last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+            for (auto cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    std::vector<std::vector<int>> m_nodes;
+};
@@ -10,7 +10,10 @@
 class parser_t
 {
 public:
-    parser_t() = default;
+    explicit parser_t(std::FILE * input = stdin)
+        : m_input{input}
+    {
+    }
 
     // Returns whole line, nullptr on EOF.
     char * read_line()
@@ -68,8 +71,9 @@ private:
     // Returns whole line from stdin, nullptr on EOF.
     char * next_line()
     {
-        return std::fgets(m_buffer, sizeof(m_buffer), stdin);
+        return std::fgets(m_buffer, sizeof(m_buffer), m_input);
     }
 
+    std::FILE * m_input;
     char m_buffer[2048];
 };
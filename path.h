@@ -8,218 +8,305 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <iostream>
+#include <memory>
 #include <numeric>
 #include <vector>
 
+#include "checkpoint.h"
 #include "city.h"
+#include "matrix.h"
 #include "random.h"
-
-//extern config g_config;
-extern std::atomic<bool> g_continue_run;
+#include "screen.h"
+#include "stream.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
-static constexpr double get_last_t(std::size_t cities)
-{
-    if (cities < 55)
-        return 0.005;
-
-    if (cities < 105)
-        return 0.002;
-
-    return 0.001;
-}
-
 static constexpr std::uint16_t bound_value(std::uint16_t rnd, std::uint16_t range)
 {
     std::uint32_t x = static_cast<std::uint32_t>(rnd) * static_cast<std::uint32_t>(range);
     return x >> 16;
 }
 
+// Another 64 random bits derived from the given ones (splitmix64 finalizer).
+static constexpr std::uint64_t remix(std::uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// Operators proposing the moves, select_city is used always.
+enum operators_t : unsigned
+{
+    USE_SWAP    = 1,
+    USE_REVERSE = 2,
+    USE_INSERT  = 4,
+    USE_ALL     = USE_SWAP | USE_REVERSE | USE_INSERT,
+
+    // Compound operators, exchange of two segments of days and swap or
+    // insert together with the best cities of the moved areas.
+    USE_SEGMENTS = 8,
+    USE_RESELECT = 16,
+};
+
+// Moves proposed by the operators.
+enum method_t : std::uint8_t { SWAP_AREAS, REVERSE_AREAS, INSERT_AREA, SELECT_CITY, SWAP_SEGMENTS, SWAP_RESELECT, INSERT_RESELECT, METHODS_COUNT };
+
+// Counters of a run.
+struct solver_stats_t
+{
+    std::uint64_t iterations = 0;
+    std::uint64_t accepted[METHODS_COUNT] = {};
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+// The path is specialized at compile time by the type of the indexes (of
+// cities, days and areas, the narrower the smaller working set) and by the
+// set of the operators (unused ones cost nothing). It holds the state and
+// prices the moves, the search is done by the engines (see solver.h).
+template <typename Index = std::uint16_t, unsigned Ops = USE_ALL>
 class areapath_t
 {
 public:
-    areapath_t(std::vector<area_t> && areas_list, const cities_map_t * cities_indexer, const matrix<std::uint16_t> * costs_matrix)
-        : m_path{std::move(areas_list)}
-        , m_area_to_day(m_path.size() + 1)
-        , m_day_to_area(m_path.size() + 1)
+    typedef Index index_t;
+    static constexpr unsigned ops = Ops;
+
+    // The cities are 16-bit from the parser to the print, so are the random indexes.
+    static_assert(sizeof(Index) <= sizeof(std::uint16_t), "The indexes are at most 16-bit!");
+
+    // Whether the index type can hold all indexes of the instance (and the loops over them can end).
+    static constexpr bool fits(std::size_t cities_count, std::size_t areas_count) noexcept
+    {
+        return std::max(cities_count, areas_count + 2) <= std::numeric_limits<Index>::max();
+    }
+
+    // The order of the areas is random by the seed.
+    areapath_t(const std::vector<area_t> & areas_list, const cities_map_t * cities_indexer, const matrix<std::uint16_t> * costs_matrix, std::uint64_t seed = 0)
+        : m_day_to_area(areas_list.size() + 1)
+        , m_area_to_day(areas_list.size() + 1)
         , m_cities_indexer{cities_indexer}
         , m_costs{costs_matrix}
     {
+        assert(fits(costs_matrix->dim(), areas_list.size()));
+
+        m_path.reserve(areas_list.size() + 1);
+        for (const auto & area : areas_list)
+            m_path.emplace_back(area.begin(), area.end());
+
         // Set tha last area same as the first.
         m_path.push_back(m_path[0]);
 
         // Init supported structures.
-        std::iota(m_day_to_area.begin(), m_day_to_area.end(), static_cast<std::uint16_t>(0));
-        std::random_shuffle(m_day_to_area.begin() + 1, m_day_to_area.begin() + m_path.size() - 1);
-        for (std::uint16_t i = 0; i < m_day_to_area.size(); ++i)
+        std::iota(m_day_to_area.begin(), m_day_to_area.end(), static_cast<Index>(0));
+
+        // Fisher-Yates, the same order with any standard library.
+        rnd_gen_t rng(seed);
+        for (std::size_t i = m_path.size() - 2; i > 1; --i)
+            std::swap(m_day_to_area[i], m_day_to_area[1 + rng() % i]);
+        for (Index i = 0; i < m_day_to_area.size(); ++i)
             m_area_to_day[m_day_to_area[i]] = i;
 
         // Generate array with zones with swithable cities.
         // Don't count the first one but count the last one.
         m_cities_choises.reserve(200);
-        for (std::uint16_t i = 1; i < m_path.size(); ++i)
-            for (std::uint16_t j = 1; j < m_path[i].size(); ++j)
+        for (Index i = 1; i < m_path.size(); ++i)
+            for (Index j = 1; j < m_path[i].size(); ++j)
                 m_cities_choises.push_back({i, j});
         m_cities_choises.shrink_to_fit();
+
+        // There are fewer choices than cities, the random choice is 16-bit.
+        assert(m_cities_choises.size() <= std::numeric_limits<std::uint16_t>::max());
     }
 
-    void optimize()
+    struct area_city_t
     {
-        rnd_gen_t rng(std::chrono::system_clock::now().time_since_epoch().count());
+        Index zone_idx;
+        Index city_pos;
+    };
 
-        auto min_path = *this;
-        auto min_cost = cost();
+    struct move_t
+    {
+        method_t method;
+        Index i;
+        Index j;
+        std::int32_t cost_diff;
+        // Ends of the segments or positions of the selected cities (compound moves only).
+        Index p;
+        Index q;
+    };
 
-        auto actual_cost = min_cost;
+    // The cheapest of the moves given by the random number. With the screening
+    // the moves (of every operator) whose lower bound by the screening
+    // matrix is above the limit (see acceptance_limit()) aren't priced
+    // exactly, so the move is the same unless it would be rejected.
+    template <bool Screen = false>
+    move_t propose(std::uint64_t xrnd, double limit = 0) const noexcept
+    {
+        static_assert(sizeof xrnd == 8, "Bad random number generator!");
 
-        // Some constants for temperature computing.
-        auto Tn = /*g_config.iterations*/ 80'000'000;
-        auto exp_base = std::log(get_last_t(m_path.size()));
+        // Randomly choose two indexes.
+        Index i, j;
 
-        double actual_T = 1.0;
+        // generate indexes 1..m_path.size()
+        i = static_cast<Index>(bound_value(static_cast<std::uint16_t>(xrnd), static_cast<std::uint16_t>(m_path.size()) - 2) + 1);
+        j = static_cast<Index>(bound_value(static_cast<std::uint16_t>(xrnd >> 16), static_cast<std::uint16_t>(m_path.size()) - 2) + 1);
 
-        unsigned int iter = 0;
-        while (g_continue_run)
-        {
-            if (iter++ % 512 /*g_config.recomp_T*/ == 0)
-                actual_T = std::exp(exp_base * std::pow(iter / (double)Tn, 0.3));
+        // Compute the best price.
+        move_t move = {SWAP_AREAS, i, j, std::numeric_limits<std::int32_t>::max(), 0, 0};
 
-            // Randomly choose two indexes.
-            std::uint16_t i, j;
+        if ((Ops & USE_SWAP) && (!Screen || swap_areas_cost_diff(i, j, floor_prices()) <= limit))
+            move.cost_diff = swap_areas_cost_diff(i, j);
 
-            // Compute the best price.
-            enum method_t { SWAP_AREAS, REVERSE_AREAS, INSERT_AREA, SELECT_CITY } method;
-            auto cost_diff = std::numeric_limits<std::int32_t>::max();
+        if ((Ops & USE_REVERSE) && (!Screen || reverse_cost_diff(i, j, floor_prices()) <= limit))
+        {
+            auto price = reverse_cost_diff(i, j);
+            if (price < move.cost_diff)
+                move = {REVERSE_AREAS, i, j, price, 0, 0};
+        }
 
-            auto xrnd = rng();
-            static_assert(sizeof xrnd == 8, "Bad random number generator!");
+        if ((Ops & USE_INSERT) && (!Screen || insert_cost_diff(i, j, floor_prices()) <= limit))
+        {
+            auto price = insert_cost_diff(i, j);
+            if (price < move.cost_diff)
+                move = {INSERT_AREA, i, j, price, 0, 0};
+        }
 
+        if (Ops & USE_SEGMENTS)
+        {
+            // The ends of the segments are given by other random bits.
+            auto extra = remix(xrnd) >> 32;
+            auto k = std::min(i, j);
+            auto l = std::max(i, j);
+            auto p = static_cast<Index>(k + bound_value(static_cast<std::uint16_t>(extra), static_cast<std::uint16_t>(l - k)));
+            auto q = static_cast<Index>(p + 1 + bound_value(static_cast<std::uint16_t>(extra >> 16), static_cast<std::uint16_t>(l - p)));
+
+            if (!Screen || swap_segments_cost_diff(k, l, p, q, floor_prices()) <= limit)
             {
-                i = static_cast<std::uint16_t>(xrnd);
-                j = static_cast<std::uint16_t>(xrnd >> 16);
-
-                // generate indexes 1..m_path.size()
-                i = bound_value(i, static_cast<std::uint16_t>(m_path.size()) - 2) + 1;
-                j = bound_value(j, static_cast<std::uint16_t>(m_path.size()) - 2) + 1;
-
-                method = SWAP_AREAS;
-                cost_diff = swap_areas_cost_diff(i, j);
+                auto price = swap_segments_cost_diff(k, l, p, q);
+                if (price < move.cost_diff)
+                    move = {SWAP_SEGMENTS, k, l, price, p, q};
             }
+        }
+
+        if (Ops & USE_RESELECT)
+        {
+            Index p, q;
+            if (!Screen || swap_reselect_cost_diff(i, j, p, q, floor_prices()) <= limit)
             {
-                auto price = reverse_cost_diff(i, j);
-                if (price < cost_diff)
-                {
-                    cost_diff = price;
-                    method = REVERSE_AREAS;
-                }
+                auto price = swap_reselect_cost_diff(i, j, p, q);
+                if (price < move.cost_diff)
+                    move = {SWAP_RESELECT, std::min(i, j), std::max(i, j), price, p, q};
             }
+
+            if (!Screen || insert_reselect_cost_diff(i, j, p, floor_prices()) <= limit)
             {
-                auto price = insert_cost_diff(i, j);
-                if (price < cost_diff)
-                {
-                    cost_diff = price;
-                    method = INSERT_AREA;
-                }
+                auto price = insert_reselect_cost_diff(i, j, p);
+                if (price < move.cost_diff)
+                    move = {INSERT_RESELECT, i, j, price, p, 0};
             }
+        }
 
-            if (m_cities_choises.size())
-            {
-                auto x = static_cast<std::uint16_t>(xrnd);
-                x = bound_value(x, static_cast<std::uint16_t>(m_cities_choises.size()) - 1);
-                auto xi = m_cities_choises[x].zone_idx;
-                auto xj = m_cities_choises[x].city_pos;
+        if (m_cities_choises.size())
+        {
+            auto x = static_cast<std::uint16_t>(xrnd);
+            x = bound_value(x, static_cast<std::uint16_t>(m_cities_choises.size()) - 1);
+            auto xi = m_cities_choises[x].zone_idx;
+            auto xj = m_cities_choises[x].city_pos;
 
+            if (!Screen || select_city_cost_diff(xi, xj, floor_prices()) <= limit)
+            {
                 auto price = select_city_cost_diff(xi, xj);
-                if (price < cost_diff)
-                {
-                    method = SELECT_CITY;
-                    cost_diff = select_city_cost_diff(xi, xj);
-                    i = xi;
-                    j = xj;
-                }
+                if (price < move.cost_diff)
+                    move = {SELECT_CITY, xi, xj, price, 0, 0};
             }
+        }
 
-            // Accept? Better ways accept every time || worse only with some probability.
-            bool accept = true;
-            if (cost_diff > 0)
-            {
-                auto rnd = static_cast<std::uint32_t>(xrnd >> 32);
-                auto log_max_int = std::log(std::numeric_limits<std::uint32_t>::max());
+        return move;
+    }
 
-                auto right = (-cost_diff / (actual_T * m_costs->get_max())) + log_max_int;
-                auto left = std::log(rnd);
+    // Accept? Better ways accept every time || worse only with some probability.
+    bool accept(const move_t & move, std::uint64_t xrnd, double actual_T) const noexcept
+    {
+        if (move.cost_diff <= 0)
+            return true;
 
-                accept = (left <= right);
-            }
+        // No operator has found any move (or all of them were screened out).
+        if (move.cost_diff == std::numeric_limits<std::int32_t>::max())
+            return false;
 
-            // If the new path should be accepted, save it.
-            if (accept)
-            {
-                switch (method)
-                {
-                case SWAP_AREAS:    swap_areas(i, j);    break;
-                case REVERSE_AREAS: reverse_areas(i, j); break;
-                case INSERT_AREA:   insert_areas(i, j);  break;
-                case SELECT_CITY:   select_city(i, j);   break;
-                }
+        auto rnd = static_cast<std::uint32_t>(xrnd >> 32);
+        auto log_max_int = std::log(std::numeric_limits<std::uint32_t>::max());
 
-                actual_cost += cost_diff;
+        auto right = (-move.cost_diff / (actual_T * m_costs->get_max())) + log_max_int;
+        auto left = std::log(rnd);
 
-                // If the actual path cost is the best one, save it.
-                if (actual_cost < min_cost)
-                {
-                    min_path = *this;
-                    min_cost = actual_cost;
-                }
-            }
-        }
-        //std::cout << "pocet iteraci (new): " << iter << std::endl;
-        *this = min_path;
-        assert(min_cost == cost());
+        return (left <= right);
     }
 
-    void print(std::ostream & out) const
+    void apply(const move_t & move) noexcept
     {
-        // Print the cost.
-        out << cost() << std::endl;
-
-        // Print the path.
-        auto src_idx = static_cast<std::uint16_t>(0);
-        for (std::uint16_t i = 1; i < m_path.size(); ++i)
+        switch (move.method)
         {
-            auto dst_idx = city(i);
+        case SWAP_AREAS:    swap_areas(move.i, move.j);    break;
+        case REVERSE_AREAS: reverse_areas(move.i, move.j); break;
+        case INSERT_AREA:   insert_areas(move.i, move.j);  break;
+        case SELECT_CITY:   select_city(move.i, move.j);   break;
+        case SWAP_SEGMENTS: swap_segments(move.i, move.j, move.p, move.q); break;
+        case SWAP_RESELECT:
+            swap_areas(move.i, move.j);
+            select_city(m_day_to_area[move.i], move.p);
+            select_city(m_day_to_area[move.j], move.q);
+            break;
+        case INSERT_RESELECT:
+            insert_areas(move.i, move.j);
+            select_city(m_day_to_area[move.j], move.p);
+            break;
+        default:                                           break;
+        }
+
+        if (m_screen)
+            refresh_flights(move);
+    }
 
-            out << m_cities_indexer->get_city_object(src_idx);
-            out << ' ';
-            out << m_cities_indexer->get_city_object(dst_idx);
-            out << ' ';
-            out << i;
-            out << ' ';
-            out << m_costs->get(src_idx, dst_idx, i - 1);
-            out << std::endl;
+    // The highest cost difference accept() can accept with the random number
+    // (with a margin for its rounding, the prices are integral).
+    double acceptance_limit(std::uint64_t xrnd, double actual_T) const noexcept
+    {
+        auto rnd = static_cast<std::uint32_t>(xrnd >> 32);
+        if (rnd == 0)
+            return std::numeric_limits<double>::infinity();
 
-            src_idx = dst_idx;
-        }
+        auto log_max_int = std::log(std::numeric_limits<std::uint32_t>::max());
+        return (log_max_int - std::log(rnd)) * actual_T * m_costs->get_max() + 1;
     }
 
-private:
-    std::uint16_t city(std::uint16_t day) const noexcept
+    // Screening of the proposals by the quantized prices (see propose()), the
+    // path keeps the prices of its flights then.
+    void use_screening(const screen_matrix_t * screen)
     {
-        return m_path[m_day_to_area[day]][0];
+        m_screen = screen;
+        m_flights.resize(m_path.size() - 1);
+        refresh_days(0, m_path.size() - 2);
+    }
+
+    // Reads the prices from another (but the same) matrix, e.g. a replica local to the NUMA node.
+    void use_costs(const matrix<std::uint16_t> * costs_matrix) noexcept
+    {
+        m_costs = costs_matrix;
     }
 
     std::uint32_t cost() const noexcept
     {
         std::uint32_t sum = 0;
-        auto from = static_cast<std::uint16_t>(0);// always zero: m_path[0][0];
-        for (std::uint16_t i = 1; i < m_path.size(); ++i)
+        auto from = static_cast<Index>(0);// always zero: m_path[0][0];
+        for (Index i = 1; i < m_path.size(); ++i)
         {
             auto to = city(i);
             sum += m_costs->get(from, to, i - 1);
@@ -228,7 +315,278 @@ private:
         return sum;
     }
 
-    std::int32_t swap_areas_cost_diff(std::uint16_t i, std::uint16_t j) const noexcept
+    void print(std::ostream & out) const
+    {
+        std::vector<std::uint16_t> cities;
+        route(cities);
+        print_route(out, cities, *m_cities_indexer, *m_costs);
+    }
+
+    // Visited city for every day, the start city included.
+    void route(std::vector<std::uint16_t> & cities) const
+    {
+        cities.resize(m_path.size());
+        cities[0] = 0;
+        for (Index i = 1; i < m_path.size(); ++i)
+            cities[i] = static_cast<std::uint16_t>(city(i));
+    }
+
+    // Count of the positions of the path (the days and the return).
+    std::size_t size() const noexcept
+    {
+        return m_path.size();
+    }
+
+    Index area_at(Index day) const noexcept
+    {
+        return m_day_to_area[day];
+    }
+
+    // The city at the position in the area, the first one is the visited one.
+    Index city_of(Index area, Index pos) const noexcept
+    {
+        return m_path[area][pos];
+    }
+
+    // The areas with more cities and the positions select_city can choose.
+    const std::vector<area_city_t> & city_choices() const noexcept
+    {
+        return m_cities_choises;
+    }
+
+    // Prices the move given by its method and indexes (the compound moves
+    // choose their cities as in propose()).
+    void evaluate(move_t & move) const noexcept
+    {
+        switch (move.method)
+        {
+        case SWAP_AREAS:      move.cost_diff = swap_areas_cost_diff(move.i, move.j);                   break;
+        case REVERSE_AREAS:   move.cost_diff = reverse_cost_diff(move.i, move.j);                      break;
+        case INSERT_AREA:     move.cost_diff = insert_cost_diff(move.i, move.j);                       break;
+        case SELECT_CITY:     move.cost_diff = select_city_cost_diff(move.i, move.j);                  break;
+        case SWAP_SEGMENTS:   move.cost_diff = swap_segments_cost_diff(move.i, move.j, move.p, move.q); break;
+        case SWAP_RESELECT:   move.cost_diff = swap_reselect_cost_diff(move.i, move.j, move.p, move.q); break;
+        case INSERT_RESELECT: move.cost_diff = insert_reselect_cost_diff(move.i, move.j, move.p);       break;
+        default:              move.cost_diff = std::numeric_limits<std::int32_t>::max();               break;
+        }
+    }
+
+    // The state of the engine (a trivial type) is saved with the actual and the best path.
+    template <typename State>
+    bool save_checkpoint(const std::string & filename, const State & state, const areapath_t & min_path) const
+    {
+        return checkpoint_t::save(filename, checkpoint_header(), [&](std::ostream & out)
+        {
+            checkpoint_t::write(out, state);
+            save_path(out);
+            min_path.save_path(out);
+        });
+    }
+
+    // Loads the actual path to this and the best one to the min_path.
+    template <typename State>
+    bool load_checkpoint(const std::string & filename, State & state, areapath_t & min_path)
+    {
+        auto tmp = *this;
+        auto tmp_min = min_path;
+        auto ok = checkpoint_t::load(filename, checkpoint_header(), [&](std::istream & in)
+        {
+            return checkpoint_t::read(in, state) && tmp.load_path(in) && tmp_min.load_path(in);
+        });
+
+        if (ok)
+        {
+            *this = std::move(tmp);
+            min_path = std::move(tmp_min);
+        }
+        return ok;
+    }
+
+private:
+    // Identifies the instance (the areas and their cities). The cities are
+    // identified by their codes, the preprocessing renumbers them (and the
+    // same index may mean another city after different fare updates).
+    std::uint64_t fingerprint() const
+    {
+        auto ret = checkpoint_t::hash(14695981039346656037ull, m_path.size());
+        for (const auto & area : m_path)
+        {
+            auto codes = city_codes(area);
+            std::sort(codes.begin(), codes.end());
+
+            ret = checkpoint_t::hash(ret, codes.size());
+            for (auto code : codes)
+                ret = checkpoint_t::hash(ret, code);
+        }
+        return ret;
+    }
+
+    // The codes of the cities (their indexes depend on the preprocessing).
+    std::vector<std::uint32_t> city_codes(const std::vector<Index> & area) const
+    {
+        std::vector<std::uint32_t> codes;
+        codes.reserve(area.size());
+        for (auto city : area)
+            codes.push_back(static_cast<std::uint32_t>(m_cities_indexer->get_city_object(city).hash()));
+        return codes;
+    }
+
+    // The cities by their codes and the days in 16 bits, so the file doesn't
+    // depend on the numbering of the cities nor on the width of the indexes.
+    void save_path(std::ostream & out) const
+    {
+        for (const auto & area : m_path)
+            checkpoint_t::write(out, city_codes(area));
+        checkpoint_t::write(out, std::vector<std::uint16_t>(m_day_to_area.begin(), m_day_to_area.end()));
+    }
+
+    // Returns false if the data don't describe a path of this instance.
+    bool load_path(std::istream & in)
+    {
+        // Every area must hold the same cities (the start one in the same order).
+        for (std::size_t a = 0; a < m_path.size(); ++a)
+        {
+            auto & area = m_path[a];
+            const auto expected = city_codes(area);
+
+            std::vector<std::uint32_t> codes;
+            if (!checkpoint_t::read(in, codes) || codes.size() != expected.size())
+                return false;
+
+            if (a == 0)
+            {
+                if (codes != expected)
+                    return false;
+                continue;
+            }
+
+            auto sorted = codes;
+            auto sorted_expected = expected;
+            std::sort(sorted.begin(), sorted.end());
+            std::sort(sorted_expected.begin(), sorted_expected.end());
+            if (sorted != sorted_expected)
+                return false;
+
+            // Back to the indexes of this run.
+            const auto cities = area;
+            for (std::size_t k = 0; k < codes.size(); ++k)
+                area[k] = cities[std::find(expected.begin(), expected.end(), codes[k]) - expected.begin()];
+        }
+
+        // The days must be a permutation of the areas starting and ending in the start area.
+        std::vector<std::uint16_t> day_to_area;
+        if (!checkpoint_t::read(in, day_to_area) || day_to_area.size() != m_area_to_day.size())
+            return false;
+
+        const auto last = day_to_area.size() - 1;
+        if (day_to_area[0] != 0 || day_to_area[last] != last)
+            return false;
+
+        std::vector<bool> seen(day_to_area.size(), false);
+        for (auto area : day_to_area)
+        {
+            if (area >= seen.size() || seen[area])
+                return false;
+            seen[area] = true;
+        }
+
+        m_day_to_area.assign(day_to_area.begin(), day_to_area.end());
+        for (Index i = 0; i < m_day_to_area.size(); ++i)
+            m_area_to_day[m_day_to_area[i]] = i;
+
+        if (m_screen)
+            refresh_days(0, m_path.size() - 2);
+        return true;
+    }
+
+    // The count of the cities is of the ones in the areas (the same with and
+    // without the preprocessing which doesn't prune anything).
+    checkpoint_t::header_t checkpoint_header() const
+    {
+        // The fingerprint needs the city codes.
+        assert(m_cities_indexer);
+
+        std::size_t cities = 0;
+        for (std::size_t a = 0; a + 1 < m_path.size(); ++a)
+            cities += m_path[a].size();
+
+        return checkpoint_t::make_header(static_cast<std::uint32_t>(m_path.size()),
+                                         static_cast<std::uint32_t>(cities),
+                                         fingerprint());
+    }
+
+    Index city(Index day) const noexcept
+    {
+        return m_path[m_day_to_area[day]][0];
+    }
+
+    // Prices for the kernels below, of the flights of the path (before the
+    // move) and of the new ones (after it).
+    struct exact_prices_t
+    {
+        static constexpr bool exact = true;
+
+        const matrix<std::uint16_t> * costs;
+
+        std::int32_t before(unsigned int x, unsigned int y, unsigned int day) const noexcept { return costs->get(x, y, day); }
+        std::int32_t after(unsigned int x, unsigned int y, unsigned int day) const noexcept { return costs->get(x, y, day); }
+    };
+
+    // Lower bounds for the screening, the prices of the flights of the path
+    // are known and the new ones are the floors of their buckets.
+    struct floor_prices_t
+    {
+        static constexpr bool exact = false;
+
+        const screen_matrix_t * screen;
+        const std::int32_t * flights;
+
+        std::int32_t before(unsigned int, unsigned int, unsigned int day) const noexcept { return flights[day]; }
+        std::int32_t after(unsigned int x, unsigned int y, unsigned int day) const noexcept { return screen->floor(x, y, day); }
+    };
+
+    floor_prices_t floor_prices() const noexcept
+    {
+        return {m_screen, m_flights.data()};
+    }
+
+    std::int32_t swap_areas_cost_diff(Index i, Index j) const noexcept
+    {
+        return swap_areas_cost_diff(i, j, exact_prices_t{m_costs});
+    }
+
+    std::int32_t reverse_cost_diff(Index i, Index j) const noexcept
+    {
+        return reverse_cost_diff(i, j, exact_prices_t{m_costs});
+    }
+
+    std::int32_t insert_cost_diff(Index i, Index j) const noexcept
+    {
+        return insert_cost_diff(i, j, exact_prices_t{m_costs});
+    }
+
+    std::int32_t select_city_cost_diff(Index zone_idx, Index new_city_pos) const noexcept
+    {
+        return select_city_cost_diff(zone_idx, new_city_pos, exact_prices_t{m_costs});
+    }
+
+    std::int32_t swap_segments_cost_diff(Index k, Index l, Index p, Index q) const noexcept
+    {
+        return swap_segments_cost_diff(k, l, p, q, exact_prices_t{m_costs});
+    }
+
+    std::int32_t swap_reselect_cost_diff(Index i, Index j, Index & p, Index & q) const noexcept
+    {
+        return swap_reselect_cost_diff(i, j, p, q, exact_prices_t{m_costs});
+    }
+
+    std::int32_t insert_reselect_cost_diff(Index i, Index j, Index & p) const noexcept
+    {
+        return insert_reselect_cost_diff(i, j, p, exact_prices_t{m_costs});
+    }
+
+    template <typename Prices>
+    std::int32_t swap_areas_cost_diff(Index i, Index j, const Prices & prices) const noexcept
     {
         std::int32_t before;
         std::int32_t after;
@@ -241,22 +599,22 @@ private:
         auto pj   = city(j);
         auto pjp1 = city(j + 1);
 
-        if (std::abs(i - j) > 1)
+        if (i > j + 1 || j > i + 1)
         {
-            before = m_costs->get(pim1, pi, i - 1) + m_costs->get(pi, pip1, i)
-                   + m_costs->get(pjm1, pj, j - 1) + m_costs->get(pj, pjp1, j);
-            after  = m_costs->get(pim1, pj, i - 1) + m_costs->get(pj, pip1, i)
-                   + m_costs->get(pjm1, pi, j - 1) + m_costs->get(pi, pjp1, j);
+            before = prices.before(pim1, pi, i - 1) + prices.before(pi, pip1, i)
+                   + prices.before(pjm1, pj, j - 1) + prices.before(pj, pjp1, j);
+            after  = prices.after(pim1, pj, i - 1) + prices.after(pj, pip1, i)
+                   + prices.after(pjm1, pi, j - 1) + prices.after(pi, pjp1, j);
         }
         else if (i + 1 == j)
         {
-            before = m_costs->get(pim1, pi, i - 1) + m_costs->get(pi, pj, i) + m_costs->get(pj, pjp1, j);
-            after  = m_costs->get(pim1, pj, i - 1) + m_costs->get(pj, pi, i) + m_costs->get(pi, pjp1, j);
+            before = prices.before(pim1, pi, i - 1) + prices.before(pi, pj, i) + prices.before(pj, pjp1, j);
+            after  = prices.after(pim1, pj, i - 1) + prices.after(pj, pi, i) + prices.after(pi, pjp1, j);
         }
         else if (i - 1 == j)
         {
-            before = m_costs->get(pjm1, pj, j - 1) + m_costs->get(pj, pi, j) + m_costs->get(pi, pip1, i);
-            after  = m_costs->get(pjm1, pi, j - 1) + m_costs->get(pi, pj, j) + m_costs->get(pj, pip1, i);
+            before = prices.before(pjm1, pj, j - 1) + prices.before(pj, pi, j) + prices.before(pi, pip1, i);
+            after  = prices.after(pjm1, pi, j - 1) + prices.after(pi, pj, j) + prices.after(pj, pip1, i);
         }
         else
         {
@@ -267,7 +625,8 @@ private:
         return after - before;
     }
 
-    std::int32_t reverse_cost_diff(std::uint16_t i, std::uint16_t j) const noexcept
+    template <typename Prices>
+    std::int32_t reverse_cost_diff(Index i, Index j, const Prices & prices) const noexcept
     {
         auto k = std::min(i, j);
         auto l = std::max(i, j);
@@ -275,20 +634,21 @@ private:
         if (l - k > 30)
             return std::numeric_limits<std::int32_t>::max();
 
-        auto before = m_costs->get(city(k - 1), city(k), k - 1) + m_costs->get(city(l), city(l + 1), l);
-        auto after  = m_costs->get(city(k - 1), city(l), k - 1) + m_costs->get(city(k), city(l + 1), l);
+        auto before = prices.before(city(k - 1), city(k), k - 1) + prices.before(city(l), city(l + 1), l);
+        auto after  = prices.after(city(k - 1), city(l), k - 1) + prices.after(city(k), city(l + 1), l);
 
         auto end = l - k;
-        for (std::uint16_t idx = 0; idx < end; ++idx)
+        for (Index idx = 0; idx < end; ++idx)
         {
-            before += m_costs->get(city(k + idx), city(k + idx + 1), k + idx);
-            after  += m_costs->get(city(l - idx), city(l - idx - 1), k + idx);
+            before += prices.before(city(k + idx), city(k + idx + 1), k + idx);
+            after  += prices.after(city(l - idx), city(l - idx - 1), k + idx);
         }
 
         return after - before;
     }
 
-    std::int32_t insert_cost_diff(std::uint16_t i, std::uint16_t j) const noexcept
+    template <typename Prices>
+    std::int32_t insert_cost_diff(Index i, Index j, const Prices & prices) const noexcept
     {
         std::int32_t before;
         std::int32_t after;
@@ -298,18 +658,18 @@ private:
             if (j - i > 30)
                 return std::numeric_limits<std::int32_t>::max();
 
-            before = m_costs->get(city(i - 1), city(i), i - 1)
-                   + m_costs->get(city(j - 1), city(j), j - 1)
-                   + m_costs->get(city(j), city(j + 1), j);
+            before = prices.before(city(i - 1), city(i), i - 1)
+                   + prices.before(city(j - 1), city(j), j - 1)
+                   + prices.before(city(j), city(j + 1), j);
 
-            after = m_costs->get(city(i - 1), city(i + 1), i - 1)
-                  + m_costs->get(city(j), city(i), j - 1)
-                  + m_costs->get(city(i), city(j + 1), j);
+            after = prices.after(city(i - 1), city(i + 1), i - 1)
+                  + prices.after(city(j), city(i), j - 1)
+                  + prices.after(city(i), city(j + 1), j);
 
-            for (std::uint16_t k = i; k < j - 1; ++k)
+            for (Index k = i; k < j - 1; ++k)
             {
-                before += m_costs->get(city(k), city(k + 1), k);
-                after  += m_costs->get(city(k + 1), city(k + 2), k);
+                before += prices.before(city(k), city(k + 1), k);
+                after  += prices.after(city(k + 1), city(k + 2), k);
             }
         }
         else if (j < i)
@@ -317,18 +677,18 @@ private:
             if (i - j > 30)
                 return std::numeric_limits<std::int32_t>::max();
 
-            before = m_costs->get(city(j - 1), city(j), j - 1)
-                   + m_costs->get(city(j), city(j + 1), j)
-                   + m_costs->get(city(i), city(i + 1), i);
+            before = prices.before(city(j - 1), city(j), j - 1)
+                   + prices.before(city(j), city(j + 1), j)
+                   + prices.before(city(i), city(i + 1), i);
 
-            after = m_costs->get(city(j - 1), city(i), j - 1)
-                  + m_costs->get(city(i), city(j), j)
-                  + m_costs->get(city(i - 1), city(i + 1), i);
+            after = prices.after(city(j - 1), city(i), j - 1)
+                  + prices.after(city(i), city(j), j)
+                  + prices.after(city(i - 1), city(i + 1), i);
 
-            for (std::uint16_t k = j + 1; k < i; ++k)
+            for (Index k = j + 1; k < i; ++k)
             {
-                before += m_costs->get(city(k), city(k + 1), k);
-                after  += m_costs->get(city(k - 1), city(k), k);
+                before += prices.before(city(k), city(k + 1), k);
+                after  += prices.after(city(k - 1), city(k), k);
             }
         }
         else
@@ -340,7 +700,8 @@ private:
         return after - before;
     }
 
-    std::int32_t select_city_cost_diff(std::uint16_t zone_idx, std::uint16_t new_city_pos) const noexcept
+    template <typename Prices>
+    std::int32_t select_city_cost_diff(Index zone_idx, Index new_city_pos, const Prices & prices) const noexcept
     {
         // zone_idx will never be index of zone on day zero, because on day zero there is always one city
         // and it is ensured that we generate only zone_idx of zones with more than one city.
@@ -348,27 +709,154 @@ private:
         auto day = m_area_to_day[zone_idx];
         auto city_before_idx = city(day - 1);
 
-        std::int32_t before = m_costs->get(city_before_idx, m_path[zone_idx][0], day - 1);
-        std::int32_t after  = m_costs->get(city_before_idx, m_path[zone_idx][new_city_pos], day - 1);
+        std::int32_t before = prices.before(city_before_idx, m_path[zone_idx][0], day - 1);
+        std::int32_t after  = prices.after(city_before_idx, m_path[zone_idx][new_city_pos], day - 1);
 
         if (day < m_path.size() - 1)
         {
             auto city_after_idx = city(day + 1);
-            before += m_costs->get(m_path[zone_idx][0], city_after_idx, day);
-            after  += m_costs->get(m_path[zone_idx][new_city_pos], city_after_idx, day);
+            before += prices.before(m_path[zone_idx][0], city_after_idx, day);
+            after  += prices.after(m_path[zone_idx][new_city_pos], city_after_idx, day);
+        }
+
+        return after - before;
+    }
+
+    // The days [k, p] and [q, l] (k <= p < q <= l) exchange their areas, the days between them keep their order.
+    template <typename Prices>
+    std::int32_t swap_segments_cost_diff(Index k, Index l, Index p, Index q, const Prices & prices) const noexcept
+    {
+        if (l - k > 30 || k == l)
+            return std::numeric_limits<std::int32_t>::max();
+
+        // The area at the day d after the move is the one at segment_source() now.
+        std::int32_t before = 0;
+        std::int32_t after  = 0;
+
+        auto prev = city(k - 1);
+        for (Index d = k; d <= l; ++d)
+        {
+            auto to = city(segment_source(k, l, p, q, d));
+            before += prices.before(city(d - 1), city(d), d - 1);
+            after  += prices.after(prev, to, d - 1);
+            prev = to;
         }
+        before += prices.before(city(l), city(l + 1), l);
+        after  += prices.after(prev, city(l + 1), l);
 
         return after - before;
     }
 
-    void swap_areas(std::uint16_t i, std::uint16_t j) noexcept
+    static Index segment_source(Index k, Index l, Index p, Index q, Index day) noexcept
+    {
+        auto second = l - q + 1;
+        auto middle = q - p - 1;
+        auto offset = day - k;
+
+        if (offset < second)
+            return static_cast<Index>(q + offset);
+        if (offset < second + middle)
+            return static_cast<Index>(p + 1 + offset - second);
+        return static_cast<Index>(k + offset - second - middle);
+    }
+
+    // The cheapest city of the area at the day between the given cities, returns the price of its two flights.
+    template <typename Prices>
+    std::int32_t best_city(Index area, Index from, Index to, Index day, Index & pos, const Prices & prices) const noexcept
+    {
+        const auto & cities = m_path[area];
+
+        pos = 0;
+        std::int32_t best = prices.after(from, cities[0], day - 1) + prices.after(cities[0], to, day);
+        for (Index c = 1; c < cities.size(); ++c)
+        {
+            std::int32_t price = prices.after(from, cities[c], day - 1) + prices.after(cities[c], to, day);
+            if (price < best)
+            {
+                best = price;
+                pos = c;
+            }
+        }
+        return best;
+    }
+
+    // Swap of the areas at the days i and j, the area moved to min(i, j) gets
+    // the city at the position p and the other one the city at q.
+    template <typename Prices>
+    std::int32_t swap_reselect_cost_diff(Index i, Index j, Index & p, Index & q, const Prices & prices) const noexcept
+    {
+        auto k = std::min(i, j);
+        auto l = std::max(i, j);
+        if (k == l)
+            return std::numeric_limits<std::int32_t>::max();
+
+        auto area_k = m_day_to_area[k];
+        auto area_l = m_day_to_area[l];
+
+        std::int32_t before = prices.before(city(k - 1), city(k), k - 1) + prices.before(city(l), city(l + 1), l);
+        std::int32_t after;
+
+        if (l > k + 1)
+        {
+            before += prices.before(city(k), city(k + 1), k) + prices.before(city(l - 1), city(l), l - 1);
+            after = best_city(area_l, city(k - 1), city(k + 1), k, p, prices)
+                  + best_city(area_k, city(l - 1), city(l + 1), l, q, prices);
+        }
+        else if (Prices::exact)
+        {
+            // Neighbours, the cities are chosen one after another (the one at k for the actual city at l first).
+            before += prices.before(city(k), city(l), k);
+            best_city(area_l, city(k - 1), city(k), k, p, prices);
+            after = best_city(area_k, m_path[area_l][p], city(l + 1), l, q, prices)
+                  + prices.after(city(k - 1), m_path[area_l][p], k - 1);
+        }
+        else
+        {
+            // The greedy choice by the lower bounds isn't a lower bound of the exact one, the cheapest pair is.
+            before += prices.before(city(k), city(l), k);
+            after = std::numeric_limits<std::int32_t>::max();
+            for (Index c = 0; c < m_path[area_l].size(); ++c)
+            {
+                Index pos;
+                auto from = m_path[area_l][c];
+                auto price = best_city(area_k, from, city(l + 1), l, pos, prices) + prices.after(city(k - 1), from, k - 1);
+                if (price < after)
+                {
+                    after = price;
+                    p = c;
+                    q = pos;
+                }
+            }
+        }
+
+        return after - before;
+    }
+
+    // Insert of the area at the day i to the day j with its cheapest city there (at the position p).
+    template <typename Prices>
+    std::int32_t insert_reselect_cost_diff(Index i, Index j, Index & p, const Prices & prices) const noexcept
+    {
+        auto price = insert_cost_diff(i, j, prices);
+        if (i == j || price == std::numeric_limits<std::int32_t>::max())
+            return std::numeric_limits<std::int32_t>::max();
+
+        // Neighbours of the moved area after the insert.
+        auto from = (i < j) ? city(j) : city(j - 1);
+        auto to   = (i < j) ? city(j + 1) : city(j);
+        auto actual = city(i);
+
+        return price - prices.after(from, actual, j - 1) - prices.after(actual, to, j)
+                     + best_city(m_day_to_area[i], from, to, j, p, prices);
+    }
+
+    void swap_areas(Index i, Index j) noexcept
     {
         std::swap(m_day_to_area[i], m_day_to_area[j]);
         m_area_to_day[m_day_to_area[i]] = i;
         m_area_to_day[m_day_to_area[j]] = j;
     }
 
-    void reverse_areas(std::uint16_t i, std::uint16_t j) noexcept
+    void reverse_areas(Index i, Index j) noexcept
     {
         auto k = std::min(i, j);
         auto l = std::max(i, j);
@@ -378,13 +866,13 @@ private:
         {
             std::swap(m_day_to_area[idx], m_day_to_area[k + l - idx]);
             m_area_to_day[m_day_to_area[idx]] = idx;
-            m_area_to_day[m_day_to_area[k + l - idx]] = k + l - idx;
+            m_area_to_day[m_day_to_area[k + l - idx]] = static_cast<Index>(k + l - idx);
         }
     }
 
-    void insert_areas(std::uint16_t i, std::uint16_t j) noexcept
+    void insert_areas(Index i, Index j) noexcept
     {
-        std::uint16_t k, l;
+        Index k, l;
 
         auto tmp = m_day_to_area[i];
         if (i < j)
@@ -409,23 +897,58 @@ private:
             m_area_to_day[m_day_to_area[m]] = m;
     }
 
-    void select_city(std::uint16_t zone_idx, std::uint16_t new_city_pos) noexcept
+    void swap_segments(Index k, Index l, Index p, Index q) noexcept
+    {
+        // [k, p] [p + 1, q - 1] [q, l] -> [q, l] [p + 1, q - 1] [k, p]
+        auto first = m_day_to_area.begin() + k;
+        auto last = m_day_to_area.begin() + l + 1;
+        std::rotate(first, m_day_to_area.begin() + q, last);
+        std::rotate(first + (l - q + 1), first + (l - q + 1) + (p - k + 1), last);
+
+        for (auto m = k; m < l + 1; ++m)
+            m_area_to_day[m_day_to_area[m]] = m;
+    }
+
+    void select_city(Index zone_idx, Index new_city_pos) noexcept
     {
         std::swap(m_path[zone_idx][0], m_path[zone_idx][new_city_pos]);
     }
 
-    struct area_city_t
+    // Updates the prices of the flights of the days changed by the move.
+    void refresh_flights(const move_t & move) noexcept
     {
-        std::uint16_t zone_idx;
-        std::uint16_t city_pos;
-    };
+        switch (move.method)
+        {
+        case SWAP_AREAS:
+        case SWAP_RESELECT:
+            refresh_days(move.i - 1, move.i);
+            refresh_days(move.j - 1, move.j);
+            break;
+        case SELECT_CITY:
+        {
+            auto day = m_area_to_day[move.i];
+            refresh_days(day - 1, day);
+            break;
+        }
+        default:
+            refresh_days(std::min(move.i, move.j) - 1, std::max(move.i, move.j));
+            break;
+        }
+    }
+
+    void refresh_days(std::size_t first, std::size_t last) noexcept
+    {
+        last = std::min(last, m_path.size() - 2);
+        for (auto day = first; day <= last; ++day)
+            m_flights[day] = m_costs->get(city(static_cast<Index>(day)), city(static_cast<Index>(day + 1)), static_cast<unsigned int>(day));
+    }
 
     // The path!
-    std::vector<area_t> m_path;
+    std::vector<std::vector<Index>> m_path;
     // Supported structures (permutation & inverze permutation) to be able to find
     // effectively areas before and after a chosen area at a day.
-    std::vector<std::uint16_t> m_day_to_area;
-    std::vector<std::uint16_t> m_area_to_day;
+    std::vector<Index> m_day_to_area;
+    std::vector<Index> m_area_to_day;
 
     // The vector of pairs (area idx, city position in area) for areas where is more
     // than one city. To be able to switch cities in a areas.
@@ -434,4 +957,11 @@ private:
     // A sources of data.
     const cities_map_t * m_cities_indexer;
     const matrix<std::uint16_t> * m_costs;
+
+    // Screening of the proposals (optional) and the prices of the flights of the path for it.
+    const screen_matrix_t * m_screen = nullptr;
+    std::vector<std::int32_t> m_flights;
 };
+
+template <typename Index, unsigned Ops>
+constexpr unsigned areapath_t<Index, Ops>::ops;
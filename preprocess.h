@@ -0,0 +1,231 @@
+/**
+ * @author Petr Lavicka
+ * @copyright
+ * @file
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "city.h"
+#include "matrix.h"
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Removes the cities no optimal path needs from the areas (the start area is
+// kept as it is). A city is unreachable if there is no day it can be entered
+// on (from a city of another area, or the start city on the first day) and
+// left on the next day by real flights. A city is dominated by another city
+// of its area if none of its flights to and from the other areas is cheaper
+// on any day, the path never gets worse by visiting the other one instead
+// (of the equal cities the last one is kept, the earlier ones are dominated
+// by it as they are checked in the order of the area). Every area keeps a
+// city.
+class area_pruning_t
+{
+public:
+    area_pruning_t(std::vector<area_t> & areas_list, const matrix<std::uint16_t> * costs_matrix)
+        : m_areas(areas_list)
+        , m_days(areas_list.size())
+        , m_costs{costs_matrix}
+    {
+    }
+
+    void run()
+    {
+        // The removed cities make others unreachable.
+        std::size_t removed;
+        do
+        {
+            removed = 0;
+            for (std::size_t a = 1; a < m_areas.size(); ++a)
+                removed += remove_cities(a, m_unreachable, [&](std::uint16_t city) { return !reachable(a, city); });
+        }
+        while (removed);
+
+        for (std::size_t a = 1; a < m_areas.size(); ++a)
+        {
+            remove_cities(a, m_dominated, [&](std::uint16_t city)
+            {
+                for (auto other : m_areas[a])
+                    if (other != city && dominates(a, other, city))
+                        return true;
+                return false;
+            });
+        }
+    }
+
+    const std::vector<std::uint16_t> & unreachable() const noexcept
+    {
+        return m_unreachable;
+    }
+
+    const std::vector<std::uint16_t> & dominated() const noexcept
+    {
+        return m_dominated;
+    }
+
+private:
+    static constexpr std::int32_t no_flight = std::numeric_limits<std::uint16_t>::max();
+
+    // Removes the cities of the area matching the predicate (but the last one).
+    template <typename Pred>
+    std::size_t remove_cities(std::size_t a, std::vector<std::uint16_t> & removed, Pred && pred)
+    {
+        auto & area = m_areas[a];
+
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < area.size() && area.size() > 1;)
+        {
+            if (pred(area[i]))
+            {
+                removed.push_back(area[i]);
+                area.erase(area.begin() + i);
+                ++count;
+            }
+            else
+                ++i;
+        }
+        return count;
+    }
+
+    // Whether the predicate holds for all the cities a path can leave from on the day to the area.
+    template <typename Pred>
+    bool all_sources(std::size_t day, std::size_t area, Pred && pred) const
+    {
+        if (day == 0)
+            return pred(0);
+
+        return all_middle(area, pred);
+    }
+
+    // Whether the predicate holds for all the cities a path can go to on the day from the area.
+    template <typename Pred>
+    bool all_targets(std::size_t day, std::size_t area, Pred && pred) const
+    {
+        if (day + 1 == m_days)
+        {
+            for (auto city : m_areas[0])
+                if (!pred(city))
+                    return false;
+            return true;
+        }
+
+        return all_middle(area, pred);
+    }
+
+    // The cities of the areas other than the start one and the given one.
+    template <typename Pred>
+    bool all_middle(std::size_t area, Pred && pred) const
+    {
+        for (std::size_t b = 1; b < m_areas.size(); ++b)
+        {
+            if (b == area)
+                continue;
+
+            for (auto city : m_areas[b])
+                if (!pred(city))
+                    return false;
+        }
+        return true;
+    }
+
+    bool reachable(std::size_t area, std::uint16_t city) const
+    {
+        // The city is at the day between the entering and the leaving flight.
+        for (std::size_t day = 1; day < m_days; ++day)
+        {
+            auto enter = static_cast<unsigned int>(day - 1);
+            auto leave = static_cast<unsigned int>(day);
+
+            if (all_sources(enter, area, [&](std::uint16_t from) { return m_costs->get(from, city, enter) == no_flight; }))
+                continue;
+
+            if (!all_targets(leave, area, [&](std::uint16_t to) { return m_costs->get(city, to, leave) == no_flight; }))
+                return true;
+        }
+        return false;
+    }
+
+    // Whether the city is never cheaper than the other one of the same area.
+    bool dominates(std::size_t area, std::uint16_t other, std::uint16_t city) const
+    {
+        for (std::size_t day = 0; day + 1 < m_days; ++day)
+        {
+            auto enter = static_cast<unsigned int>(day);
+            if (!all_sources(day, area, [&](std::uint16_t from) { return m_costs->get(from, other, enter) <= m_costs->get(from, city, enter); }))
+                return false;
+
+            auto leave = static_cast<unsigned int>(day + 1);
+            if (!all_targets(day + 1, area, [&](std::uint16_t to) { return m_costs->get(other, to, leave) <= m_costs->get(city, to, leave); }))
+                return false;
+        }
+        return true;
+    }
+
+    std::vector<area_t> & m_areas;
+    const std::size_t m_days;
+
+    // The removed cities.
+    std::vector<std::uint16_t> m_unreachable;
+    std::vector<std::uint16_t> m_dominated;
+
+    // A sources of data.
+    const matrix<std::uint16_t> * m_costs;
+};
+
+constexpr std::int32_t area_pruning_t::no_flight;
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Renumbers the cities of the areas in their order (the start city stays 0)
+// and shrinks the matrix to them, the cities out of the areas are dropped.
+// Returns the number of the dropped cities.
+static std::size_t compact_cities(std::vector<area_t> & areas_list, cities_map_t & cities_indexer, matrix<std::uint16_t> & costs_matrix, page_mode_t pages)
+{
+    const auto dim = costs_matrix.dim();
+
+    std::vector<int> new_index(dim, -1);
+    for (const auto & area : areas_list)
+        for (auto city : area)
+            new_index[city] = 0;
+
+    std::vector<std::uint16_t> old_index;
+    for (unsigned int city = 0; city < dim; ++city)
+    {
+        if (new_index[city] < 0)
+            continue;
+
+        new_index[city] = static_cast<int>(old_index.size());
+        old_index.push_back(static_cast<std::uint16_t>(city));
+    }
+
+    const auto count = static_cast<unsigned int>(old_index.size());
+    if (count == dim)
+        return 0;
+
+    // There are at least as many cities as areas, so the days fit.
+    matrix<std::uint16_t> compacted;
+    compacted.set_dim(count, pages);
+    for (unsigned int x = 0; x < count; ++x)
+        for (unsigned int y = 0; y < count; ++y)
+            for (unsigned int day = 0; day < count; ++day)
+            {
+                auto price = costs_matrix.get(old_index[x], old_index[y], day);
+                if (price != std::numeric_limits<std::uint16_t>::max())
+                    compacted.set(x, y, day, static_cast<std::uint16_t>(price));
+            }
+    costs_matrix.swap(compacted);
+
+    cities_indexer.compact(new_index);
+    for (auto & area : areas_list)
+        for (auto & city : area)
+            city = static_cast<std::uint16_t>(new_index[city]);
+
+    return dim - count;
+}
@@ -0,0 +1,235 @@
+/**
+ * @author Petr Lavicka
+ * @copyright
+ * @file
+ *
+ * Python extension running the annealing of the program (see ts.py for the
+ * same algorithm in Python). Build: python setup.py build_ext --inplace
+ *
+ *   path, cost, counters = pykiwi.solve(costs, zones, time=3.0)
+ *
+ * costs: C-contiguous 3D array of uint16 prices [from, to, day] with the same
+ *        size in all dimensions, 65535 means there is no flight. The array is
+ *        used directly (no copy) and must not change during the call.
+ * zones: list of lists of city indexes, the first zone is the start one and
+ *        its first city is the start city with the index 0.
+ * Returns the visited city for every day (the start city included), the cost
+ * and a dict with the counters of iterations and accepted moves. The path has
+ * the default operators (swap, reverse, insert, city selection), the compound
+ * ones (use_segments, use_reselect of the program) aren't used.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "city.h"
+#include "config.h"
+#include "matrix.h"
+#include "anneal.h"
+#include "path.h"
+#include "trace.h"
+
+// Globals used by the solver.
+config g_config;
+std::atomic<bool> g_continue_run(true);
+std::atomic<bool> g_checkpoint_request(false);
+trace_t g_trace;
+
+// The solver stops by the global flag, so there is one run at a time.
+static std::mutex g_solve_mutex;
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename Index>
+static solver_stats_t run(const std::vector<area_t> & zones, const matrix<std::uint16_t> & costs, std::vector<std::uint16_t> & route, std::uint32_t & cost)
+{
+    // There are no city codes, the config is the default one without the checkpoints.
+    assert(g_config.checkpoint_file.empty() && g_config.resume_file.empty());
+    areapath_t<Index> path(zones, nullptr, &costs);
+    auto stats = annealing_t<areapath_t<Index>>().run(path, solver_context_t());
+
+    path.route(route);
+    cost = path.cost();
+    return stats;
+}
+
+static bool is_uint16_format(const char * format)
+{
+    // Native or explicit little/big endian of the native size.
+    if (format[0] == '@' || format[0] == '=' || format[0] == '<' || format[0] == '>' || format[0] == '!')
+        ++format;
+    return std::strcmp(format, "H") == 0;
+}
+
+static bool parse_zones(PyObject * obj, std::size_t dim, std::vector<area_t> & zones)
+{
+    auto seq = PySequence_Fast(obj, "zones must be a sequence of sequences of city indexes");
+    if (!seq)
+        return false;
+
+    auto count = PySequence_Fast_GET_SIZE(seq);
+    for (Py_ssize_t i = 0; i < count; ++i)
+    {
+        auto zone_seq = PySequence_Fast(PySequence_Fast_GET_ITEM(seq, i), "zone must be a sequence of city indexes");
+        if (!zone_seq)
+        {
+            Py_DECREF(seq);
+            return false;
+        }
+
+        area_t zone;
+        auto size = PySequence_Fast_GET_SIZE(zone_seq);
+        for (Py_ssize_t j = 0; j < size; ++j)
+        {
+            auto idx = PyLong_AsLong(PySequence_Fast_GET_ITEM(zone_seq, j));
+            if (idx < 0 || static_cast<std::size_t>(idx) >= dim)
+            {
+                if (!PyErr_Occurred())
+                    PyErr_SetString(PyExc_ValueError, "city index out of the costs array");
+                Py_DECREF(zone_seq);
+                Py_DECREF(seq);
+                return false;
+            }
+            zone.push_back(static_cast<std::uint16_t>(idx));
+        }
+        Py_DECREF(zone_seq);
+
+        if (zone.empty())
+        {
+            PyErr_SetString(PyExc_ValueError, "empty zone");
+            Py_DECREF(seq);
+            return false;
+        }
+        zones.push_back(std::move(zone));
+    }
+    Py_DECREF(seq);
+
+    if (zones.size() < 2 || zones[0][0] != 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "at least two zones are needed and the first one must start with the city 0");
+        return false;
+    }
+    return true;
+}
+
+static PyObject * solve(PyObject *, PyObject * args, PyObject * kwargs)
+{
+    static const char * keywords[] = {"costs", "zones", "time", nullptr};
+
+    PyObject * costs_obj;
+    PyObject * zones_obj;
+    double time = 3.0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|d", const_cast<char **>(keywords), &costs_obj, &zones_obj, &time))
+        return nullptr;
+
+    // Zero copy access to the prices.
+    Py_buffer view;
+    if (PyObject_GetBuffer(costs_obj, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0)
+        return nullptr;
+
+    if (view.ndim != 3 || view.itemsize != 2 || !is_uint16_format(view.format)
+        || view.shape[0] != view.shape[1] || view.shape[0] != view.shape[2] || view.shape[0] > 0xffff)
+    {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_TypeError, "costs must be a C-contiguous uint16 array of the shape (n, n, n)");
+        return nullptr;
+    }
+
+    auto dim = static_cast<unsigned int>(view.shape[0]);
+    std::vector<area_t> zones;
+    if (!parse_zones(zones_obj, dim, zones))
+    {
+        PyBuffer_Release(&view);
+        return nullptr;
+    }
+
+    if (zones.size() > dim)
+    {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, "more zones than days in the costs array");
+        return nullptr;
+    }
+
+    if (!areapath_t<std::uint16_t>::fits(dim, zones.size()))
+    {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, "too many cities or zones");
+        return nullptr;
+    }
+
+    std::vector<std::uint16_t> route;
+    std::uint32_t cost = 0;
+    solver_stats_t stats;
+
+    Py_BEGIN_ALLOW_THREADS
+    {
+        std::lock_guard<std::mutex> lock(g_solve_mutex);
+
+        matrix<std::uint16_t> costs;
+        costs.attach(static_cast<std::uint16_t *>(view.buf), dim);
+
+        g_continue_run = true;
+        std::thread timeout([=]{ std::this_thread::sleep_for(std::chrono::duration<double>(time)); g_continue_run = false; });
+
+        if (areapath_t<std::uint8_t>::fits(dim, zones.size()))
+            stats = run<std::uint8_t>(zones, costs, route, cost);
+        else
+            stats = run<std::uint16_t>(zones, costs, route, cost);
+
+        timeout.join();
+    }
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&view);
+
+    auto path = PyList_New(static_cast<Py_ssize_t>(route.size()));
+    if (!path)
+        return nullptr;
+    for (std::size_t i = 0; i < route.size(); ++i)
+        PyList_SET_ITEM(path, i, PyLong_FromLong(route[i]));
+
+    auto counters = Py_BuildValue("{s:K,s:K,s:K,s:K,s:K}",
+                                  "iterations", static_cast<unsigned long long>(stats.iterations),
+                                  "swap", static_cast<unsigned long long>(stats.accepted[SWAP_AREAS]),
+                                  "reverse", static_cast<unsigned long long>(stats.accepted[REVERSE_AREAS]),
+                                  "insert", static_cast<unsigned long long>(stats.accepted[INSERT_AREA]),
+                                  "select_city", static_cast<unsigned long long>(stats.accepted[SELECT_CITY]));
+    if (!counters)
+    {
+        Py_DECREF(path);
+        return nullptr;
+    }
+
+    return Py_BuildValue("(NkN)", path, static_cast<unsigned long>(cost), counters);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static PyMethodDef g_methods[] =
+{
+    {"solve", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(solve)), METH_VARARGS | METH_KEYWORDS,
+     "solve(costs, zones, time=3.0) -> (path, cost, counters)\n\nSimulated annealing of the travelling salesman over zones."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyModuleDef g_module =
+{
+    PyModuleDef_HEAD_INIT, "pykiwi", "Travelling salesman solver (the C++ engine).", -1, g_methods,
+    nullptr, nullptr, nullptr, nullptr
+};
+
+PyMODINIT_FUNC PyInit_pykiwi()
+{
+    return PyModule_Create(&g_module);
+}
@@ -76,6 +76,19 @@ public:
         return result;
     }
 
+    // The complete internal state (to be able to save and restore the generator).
+    void get_state(std::uint64_t (&state)[2]) const noexcept
+    {
+        state[0] = m_state[0];
+        state[1] = m_state[1];
+    }
+
+    void set_state(const std::uint64_t (&state)[2]) noexcept
+    {
+        m_state[0] = state[0];
+        m_state[1] = state[1];
+    }
+
     static result_type min() noexcept { return 0;}
     static result_type max() noexcept { return std::numeric_limits<result_type>::max(); }
 
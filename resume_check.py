@@ -0,0 +1,48 @@
+# Checks that a resumed run continues exactly: python resume_check.py ./kiwi
+# Runs an instance of bench.py in the deterministic mode with the reheats on
+# once in full and once split in halves by a checkpoint, the path and the
+# reheats of the two must be the same.
+import os, subprocess, sys, tempfile
+
+from bench import generate
+
+OPTIONS = 'deterministic=1\nseed=5\nmax_reheats=20\nstall_iterations=20000\nstall_accept=0.9\ndebug=1\n'
+HALF = 200192
+
+
+def run(program, instance, options):
+    with tempfile.NamedTemporaryFile('w', suffix='.txt', delete=False) as config:
+        config.write(OPTIONS + options)
+    try:
+        with open(instance) as stdin:
+            result = subprocess.run([program, config.name], stdin=stdin, stdout=subprocess.PIPE,
+                                    stderr=subprocess.PIPE, universal_newlines=True, check=True)
+    finally:
+        os.remove(config.name)
+    events = [line for line in result.stderr.splitlines() if ' at iteration ' in line]
+    return result.stdout, events
+
+
+def main():
+    program = sys.argv[1]
+    ok = True
+    for seed, n, k in [(4, 40, 3), (10, 10, 2)]:
+        with tempfile.NamedTemporaryFile('w', suffix='.txt', delete=False) as instance:
+            generate(instance, seed, n, k)
+        checkpoint = instance.name + '.bin'
+        try:
+            full = run(program, instance.name, 'max_iterations=%d\n' % (2 * HALF))
+            first = run(program, instance.name, 'max_iterations=%d\ncheckpoint_file=%s\n' % (HALF, checkpoint))
+            second = run(program, instance.name, 'max_iterations=%d\nresume_file=%s\n' % (HALF, checkpoint))
+        finally:
+            os.remove(instance.name)
+            if os.path.exists(checkpoint):
+                os.remove(checkpoint)
+        same = full[0] == second[0] and full[1] == first[1] + second[1]
+        ok = ok and same
+        print('%d areas, %d reheats: %s' % (n, len(full[1]), 'same' if same else 'DIFFERENT'))
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,69 @@
+/**
+ * @author Petr Lavicka
+ * @copyright
+ * @file
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "matrix.h"
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Prices quantized to 8-bit buckets, log-scaled up to the maximal price (the
+// cheap flights get the fine buckets), 255 means there is no flight. It is
+// half the size of the prices, so the moves can be screened with less memory
+// traffic: the floor of the bucket is a lower bound of the price.
+class screen_matrix_t
+{
+public:
+    static constexpr std::uint8_t no_flight = std::numeric_limits<std::uint8_t>::max();
+
+    void build(const matrix<std::uint16_t> & costs, page_mode_t pages)
+    {
+        const auto max_price = costs.get_max();
+
+        // Bucket of every price, the floor is the lowest price of the bucket.
+        std::vector<std::uint8_t> bucket_of(static_cast<std::size_t>(max_price) + 1);
+        m_floor.assign(no_flight + 1, 0);
+        m_floor[no_flight] = std::numeric_limits<std::uint16_t>::max();
+
+        const auto scale = (no_flight - 1) / std::log1p(static_cast<double>(max_price));
+        for (auto price = static_cast<std::int32_t>(max_price); price >= 0; --price)
+        {
+            auto bucket = (max_price == 0) ? 0 : static_cast<int>(scale * std::log1p(static_cast<double>(price)));
+            bucket_of[price] = static_cast<std::uint8_t>(std::min(bucket, no_flight - 1));
+            m_floor[bucket_of[price]] = price;
+        }
+
+        const auto dim = costs.dim();
+        m_buckets.set_dim(dim, pages);
+        for (unsigned int x = 0; x < dim; ++x)
+            for (unsigned int y = 0; y < dim; ++y)
+                for (unsigned int z = 0; z < dim; ++z)
+                {
+                    auto price = costs.get(x, y, z);
+                    if (price != std::numeric_limits<std::uint16_t>::max())
+                        m_buckets.set(x, y, z, bucket_of[price]);
+                }
+    }
+
+    // Lower bound of the price (exact for a missing flight).
+    std::int32_t floor(unsigned int x, unsigned int y, unsigned int z) const noexcept
+    {
+        return m_floor[m_buckets.get(x, y, z)];
+    }
+
+private:
+    matrix<std::uint8_t> m_buckets;
+    std::vector<std::int32_t> m_floor;
+};
+
+constexpr std::uint8_t screen_matrix_t::no_flight;
@@ -0,0 +1,9 @@
+# Python extension with the C++ engine: python setup.py build_ext --inplace
+from setuptools import setup, Extension
+
+setup(
+    name='pykiwi',
+    ext_modules=[Extension('pykiwi', ['pykiwi.cpp'], language='c++',
+                           extra_compile_args=['-std=c++14', '-O3', '-pthread'],
+                           extra_link_args=['-pthread'])],
+)
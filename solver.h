@@ -0,0 +1,92 @@
+/**
+ * @author Petr Lavicka
+ * @copyright
+ * @file
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "config.h"
+#include "path.h"
+#include "random.h"
+#include "stream.h"
+#include "watchdog.h"
+
+extern config g_config;
+
+// The search engines drive the path (areapath_t holds the state and prices
+// the moves). An engine is a class template over the path type with
+//
+//   solver_stats_t run(Path & path, const solver_context_t & context);
+//
+// which runs until the stop and leaves the best path found in the path.
+enum class engine_t
+{
+    annealing, // anneal.h
+    tabu,      // tabu.h
+};
+
+// Where an engine reports to and what it can use, all of it is optional.
+struct solver_context_t
+{
+    // Anytime output of the improving paths.
+    solution_stream_t * stream = nullptr;
+    // Index of the chain when more of them run in parallel (only the chain
+    // zero works with the checkpoints, the others differ in the seed).
+    unsigned int chain = 0;
+    // The best path for the output on time.
+    snapshot_t * snapshot = nullptr;
+    // Quantized prices for the screening of the proposals (the annealing only).
+    const screen_matrix_t * screen = nullptr;
+};
+
+inline const char * engine_name(engine_t engine) noexcept
+{
+    switch (engine)
+    {
+    case engine_t::tabu: return "tabu";
+    default:             return "anneal";
+    }
+}
+
+// Seed of the random generator of the chain: the seed of the config in the
+// deterministic mode, the time otherwise. The chains differ in any case.
+inline std::uint64_t chain_seed(unsigned int chain)
+{
+    std::uint64_t seed = g_config.deterministic ? static_cast<std::uint64_t>(g_config.seed)
+                                                : std::chrono::system_clock::now().time_since_epoch().count();
+    return seed + chain * 0x9E3779B97F4A7C15ull;
+}
+
+// Random swaps of the days 1..last, returns the change of the cost.
+template <typename Path>
+std::int32_t perturb(Path & path, typename Path::index_t last, rnd_gen_t & rng)
+{
+    typedef typename Path::index_t index_t;
+
+    std::int32_t diff = 0;
+    for (index_t k = 0; k < last / 5 + 2; ++k)
+    {
+        typename Path::move_t move = {SWAP_AREAS, static_cast<index_t>(rng() % last + 1), static_cast<index_t>(rng() % last + 1), 0, 0, 0};
+        path.evaluate(move);
+        path.apply(move);
+        diff += move.cost_diff;
+    }
+    return diff;
+}
+
+// Returns false for an unknown name.
+inline bool parse_engine(const std::string & name, engine_t & engine) noexcept
+{
+    if (name == "anneal")
+        engine = engine_t::annealing;
+    else if (name == "tabu")
+        engine = engine_t::tabu;
+    else
+        return false;
+    return true;
+}
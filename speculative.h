@@ -0,0 +1,215 @@
+/**
+ * @author Petr Lavicka
+ * @copyright
+ * @file
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+// Speculative evaluation of the proposals of a single annealing chain.
+//
+// The owner (the annealing thread) publishes a job: a batch of random numbers
+// which are evaluated against the path of the given version. Helper threads
+// (and the owner while it waits) claim the proposals one by one, each helper
+// evaluates them on its own copy of the path which it keeps up to date by
+// replaying the log of the committed moves. The results are tagged by the job,
+// so the results of a job the owner has already left are simply ignored. The
+// owner walks the results in the order of the sequence and stops at the first
+// accepted proposal, i.e. the trajectory is the same as without the helpers.
+//
+// Path has to provide move_t, propose(), accept() and apply().
+template <typename Path>
+class speculative_evaluator_t
+{
+public:
+    typedef typename Path::move_t move_t;
+
+    // Maximal number of proposals in one job.
+    static constexpr std::size_t max_batch = 4096;
+
+    speculative_evaluator_t(const Path & owner, int helpers)
+        : m_owner(owner)
+        , m_results(max_batch)
+        , m_xrnds(max_batch)
+        , m_log(log_size)
+        , m_applied(helpers)
+        , m_paths(helpers, owner)
+    {
+        for (auto & result : m_results)
+            result.value.store(0, std::memory_order_relaxed);
+        for (auto & applied : m_applied)
+            applied.value.store(0, std::memory_order_relaxed);
+
+        for (int i = 0; i < helpers; ++i)
+            m_helpers.emplace_back([this, i]{ helper_loop(i); });
+    }
+
+    speculative_evaluator_t(const speculative_evaluator_t &) = delete;
+    speculative_evaluator_t & operator=(const speculative_evaluator_t &) = delete;
+
+    ~speculative_evaluator_t()
+    {
+        m_stop.store(true, std::memory_order_relaxed);
+        for (auto & helper : m_helpers)
+            helper.join();
+    }
+
+    // Returns the index of the first accepted proposal, count if there is none.
+    std::size_t first_accepted(const std::uint64_t * xrnds, std::size_t count, double actual_T)
+    {
+        assert(count > 0 && count <= max_batch);
+        const auto job = ++m_job;
+
+        // Publish the job, the version must be the last (helpers sync to it).
+        for (std::size_t k = 0; k < count; ++k)
+            m_xrnds[k].store(xrnds[k], std::memory_order_relaxed);
+        m_T.store(actual_T, std::memory_order_relaxed);
+        m_count.store(count, std::memory_order_relaxed);
+        m_job_version.store(m_version, std::memory_order_release);
+
+        // The first proposal is done by the owner directly.
+        m_claim.store((job << 16) | 1, std::memory_order_release);
+        if (m_owner.accept(m_owner.propose(xrnds[0]), xrnds[0], actual_T))
+            return 0;
+
+        for (std::size_t k = 1; k < count; ++k)
+        {
+            std::uint64_t result;
+            while (((result = m_results[k].value.load(std::memory_order_acquire)) >> 1) != job)
+            {
+                // Help with the unclaimed proposals instead of waiting.
+                auto claim = m_claim.load(std::memory_order_relaxed);
+                if ((claim & 0xffff) < count)
+                {
+                    claim = m_claim.fetch_add(1, std::memory_order_acq_rel);
+                    auto slot = claim & 0xffff;
+                    if (slot < count)
+                        store_result(slot, job, m_owner.accept(m_owner.propose(xrnds[slot]), xrnds[slot], actual_T));
+                }
+            }
+
+            if (result & 1)
+                return k;
+        }
+        return count;
+    }
+
+    // The owner has applied the move, the helpers replay it.
+    void commit(const move_t & move)
+    {
+        // Don't overwrite the log entries the helpers haven't replayed yet.
+        for (auto & applied : m_applied)
+            while (m_version - applied.value.load(std::memory_order_acquire) >= log_size - 1 && !m_stop.load(std::memory_order_relaxed))
+                std::this_thread::yield();
+
+        m_log[m_version % log_size] = move;
+        ++m_version;
+    }
+
+private:
+    static constexpr std::uint64_t log_size = 1 << 16;
+
+    // A counter written by one thread and polled by others. The counters are
+    // a cache line apart, so the helpers don't invalidate each other's lines
+    // (the padding is enough, the vector doesn't align to the line in C++14).
+    struct padded_counter_t
+    {
+        std::atomic<std::uint64_t> value;
+        char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+    };
+
+    // Results are monotonic in the job, a late helper can't overwrite a newer result.
+    void store_result(std::uint64_t slot, std::uint64_t job, bool accepted)
+    {
+        auto desired = (job << 1) | (accepted ? 1 : 0);
+        auto & result = m_results[slot].value;
+        auto current = result.load(std::memory_order_relaxed);
+        while ((current >> 1) < job && !result.compare_exchange_weak(current, desired, std::memory_order_release, std::memory_order_relaxed))
+            ;
+    }
+
+    void helper_loop(int idx)
+    {
+        auto & path = m_paths[idx];
+        std::uint64_t version = 0;
+        std::uint64_t job = 0;
+
+        // Catch up with the owner.
+        auto sync = [&]
+        {
+            auto target = m_job_version.load(std::memory_order_acquire);
+            while (version < target)
+            {
+                path.apply(m_log[version % log_size]);
+                ++version;
+            }
+            m_applied[idx].value.store(version, std::memory_order_release);
+        };
+
+        while (!m_stop.load(std::memory_order_relaxed))
+        {
+            // Wait for a job with unclaimed proposals (and keep up with the log meanwhile).
+            auto claim = m_claim.load(std::memory_order_acquire);
+            if ((claim >> 16) == job && (claim & 0xffff) >= m_count.load(std::memory_order_relaxed))
+            {
+                sync();
+                std::this_thread::yield();
+                continue;
+            }
+
+            claim = m_claim.fetch_add(1, std::memory_order_acq_rel);
+            job = claim >> 16;
+            auto slot = claim & 0xffff;
+
+            // The job may be already replaced by a newer one, then the result is just ignored.
+            auto count = m_count.load(std::memory_order_relaxed);
+            if (slot >= count)
+                continue;
+
+            sync();
+
+            auto xrnd = m_xrnds[slot].load(std::memory_order_relaxed);
+            auto actual_T = m_T.load(std::memory_order_relaxed);
+            store_result(slot, job, path.accept(path.propose(xrnd), xrnd, actual_T));
+        }
+    }
+
+    const Path & m_owner;
+
+    // Owner's side.
+    std::uint64_t m_job = 0;
+    std::uint64_t m_version = 0;
+
+    // The job: (job << 16) | next unclaimed proposal.
+    std::atomic<std::uint64_t> m_claim{0};
+    std::atomic<std::uint64_t> m_job_version{0};
+    std::atomic<std::size_t> m_count{0};
+    std::atomic<double> m_T{0};
+    std::vector<padded_counter_t> m_results;
+    std::vector<std::atomic<std::uint64_t>> m_xrnds;
+
+    // Committed moves, a ring buffer.
+    std::vector<move_t> m_log;
+    std::vector<padded_counter_t> m_applied;
+
+    // Helpers' copies of the path.
+    std::vector<Path> m_paths;
+
+    std::atomic<bool> m_stop{false};
+    std::vector<std::thread> m_helpers;
+};
+
+template <typename Path>
+constexpr std::size_t speculative_evaluator_t<Path>::max_batch;
+
+template <typename Path>
+constexpr std::uint64_t speculative_evaluator_t<Path>::log_size;
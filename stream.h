@@ -0,0 +1,198 @@
+/**
+ * @author Petr Lavicka
+ * @copyright
+ * @file
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "city.h"
+#include "matrix.h"
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Prints the cost and the flights of the route (visited city for every day).
+static void print_route(std::ostream & out, const std::vector<std::uint16_t> & route, const cities_map_t & cities_indexer, const matrix<std::uint16_t> & costs)
+{
+    std::uint32_t sum = 0;
+    for (std::uint16_t i = 1; i < route.size(); ++i)
+        sum += costs.get(route[i - 1], route[i], i - 1);
+
+    // Print the cost.
+    out << sum << std::endl;
+
+    // Print the path.
+    for (std::uint16_t i = 1; i < route.size(); ++i)
+    {
+        out << cities_indexer.get_city_object(route[i - 1]);
+        out << ' ';
+        out << cities_indexer.get_city_object(route[i]);
+        out << ' ';
+        out << i;
+        out << ' ';
+        out << costs.get(route[i - 1], route[i], i - 1);
+        out << std::endl;
+    }
+}
+
+// Relative distance of the cost from the lower bound.
+static double gap_percent(std::uint32_t cost, std::uint32_t bound)
+{
+    return cost ? 100.0 * (static_cast<double>(cost) - bound) / cost : 0.0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Anytime output of improving solutions. The annealing thread only hands
+// the route over (and never waits for the lock), a background thread formats
+// and writes the records. Each record is a line with the elapsed time
+// (and the lower bound of the cost if it is known) followed by the print()
+// output and an empty line.
+class solution_stream_t
+{
+public:
+    typedef std::chrono::high_resolution_clock clock_t;
+
+    solution_stream_t(const std::string & filename, std::uint32_t margin, clock_t::time_point start_time,
+                      const cities_map_t * cities_indexer, const matrix<std::uint16_t> * costs_matrix)
+        : m_out(filename)
+        , m_margin{margin}
+        , m_start_time{start_time}
+        , m_cities_indexer{cities_indexer}
+        , m_costs{costs_matrix}
+        , m_writer([this]{ write_loop(); })
+    {
+    }
+
+    solution_stream_t(const solution_stream_t &) = delete;
+    solution_stream_t & operator=(const solution_stream_t &) = delete;
+
+    ~solution_stream_t()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_one();
+        m_writer.join();
+    }
+
+    // Reported with the following records.
+    void set_lower_bound(std::uint32_t bound) noexcept
+    {
+        m_lower_bound.store(bound, std::memory_order_relaxed);
+    }
+
+    // Cheap check whether the cost is worth publishing.
+    bool wants(std::uint32_t cost) const noexcept
+    {
+        auto published = m_published.load(std::memory_order_relaxed);
+        return cost < published && published - cost >= m_margin;
+    }
+
+    // Never blocks, if the writer holds the lock the route is just dropped
+    // and the next improvement will be published instead. The cost is checked
+    // again under the lock, another chain may have published a better one.
+    void publish(std::uint32_t cost, const std::vector<std::uint16_t> & route)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+        if (!lock.owns_lock() || !wants(cost))
+            return;
+
+        hand_over(cost, route);
+        lock.unlock();
+        m_cv.notify_one();
+    }
+
+    // Blocking variant for the final solution, it is written regardless of the margin.
+    void publish_final(std::uint32_t cost, const std::vector<std::uint16_t> & route)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (cost >= m_published.load(std::memory_order_relaxed))
+            return;
+
+        hand_over(cost, route);
+        lock.unlock();
+        m_cv.notify_one();
+    }
+
+private:
+    // The lock must be held and the cost must be better than the published one.
+    void hand_over(std::uint32_t cost, const std::vector<std::uint16_t> & route)
+    {
+        assert(cost < m_published.load(std::memory_order_relaxed));
+        m_pending.assign(route.begin(), route.end());
+        m_pending_time = clock_t::now() - m_start_time;
+        m_pending_cost = cost;
+        m_has_pending = true;
+        m_published.store(cost, std::memory_order_relaxed);
+    }
+
+    void write_loop()
+    {
+        std::vector<std::uint16_t> route;
+        while (true)
+        {
+            clock_t::duration elapsed;
+            std::uint32_t cost;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this]{ return m_has_pending || m_stop; });
+                if (!m_has_pending)
+                    return;
+
+                route.swap(m_pending);
+                elapsed = m_pending_time;
+                cost = m_pending_cost;
+                m_has_pending = false;
+            }
+
+            m_out << "# " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << " ms";
+            auto bound = m_lower_bound.load(std::memory_order_relaxed);
+            if (bound)
+                m_out << ", lower bound " << bound << ", gap " << std::fixed << std::setprecision(2) << gap_percent(cost, bound) << " %";
+            m_out << std::endl;
+            print_route(m_out, route, *m_cities_indexer, *m_costs);
+            m_out << std::endl;
+        }
+    }
+
+    std::ofstream m_out;
+    const std::uint32_t m_margin;
+    const clock_t::time_point m_start_time;
+
+    // The last published cost.
+    std::atomic<std::uint32_t> m_published{std::numeric_limits<std::uint32_t>::max()};
+    std::atomic<std::uint32_t> m_lower_bound{0};
+
+    // A route waiting for the writer.
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::uint16_t> m_pending;
+    clock_t::duration m_pending_time;
+    std::uint32_t m_pending_cost = 0;
+    bool m_has_pending = false;
+    bool m_stop = false;
+
+    // A sources of data.
+    const cities_map_t * m_cities_indexer;
+    const matrix<std::uint16_t> * m_costs;
+
+    // Must be the last one, it uses all the members above.
+    std::thread m_writer;
+};
@@ -0,0 +1,234 @@
+/**
+ * @author Petr Lavicka
+ * @copyright
+ * @file
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "config.h"
+#include "path.h"
+#include "random.h"
+#include "solver.h"
+#include "stream.h"
+#include "watchdog.h"
+
+extern config g_config;
+extern std::atomic<bool> g_continue_run;
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Tabu search. Every iteration prices the whole neighbourhood (all swaps,
+// the inserts and reverses up to 30 days, all city choices) and takes the
+// cheapest move which isn't tabu, even a worse one. The attributes of the
+// moved areas (area at a day, city of an area) they leave are tabu for some
+// iterations, they are kept hashed in a table (collisions only make some
+// moves tabu by mistake). A tabu move is allowed if it gives a new best
+// path (aspiration). Without an improvement for long the search restarts
+// from the best path perturbed by random swaps.
+template <typename Path>
+class tabu_search_t
+{
+public:
+    typedef typename Path::move_t move_t;
+    typedef typename Path::index_t index_t;
+
+    solver_stats_t run(Path & path, const solver_context_t & context)
+    {
+        solver_stats_t stats;
+
+        rnd_gen_t rng(chain_seed(context.chain));
+
+        const auto last = static_cast<index_t>(path.size() - 2);
+        const auto tenure = g_config.tabu_tenure ? static_cast<std::uint32_t>(g_config.tabu_tenure) : last / 4 + 5;
+        const auto stall = std::max<std::uint32_t>(1000, 50u * last);
+
+        auto min_path = path;
+        auto min_cost = path.cost();
+        auto actual_cost = min_cost;
+
+        std::vector<std::uint16_t> min_route;
+        m_tabu.assign(table_size, 0);
+
+        std::uint32_t iter = 0;
+        std::uint32_t last_improvement = 0;
+        while (g_continue_run.load(std::memory_order_relaxed) && last > 0 && (!g_config.tabu_max_iterations || iter < g_config.tabu_max_iterations))
+        {
+            ++iter;
+
+            move_t best = {SWAP_AREAS, 0, 0, std::numeric_limits<std::int32_t>::max(), 0, 0};
+            for_each_move(path, last, [&](move_t & move)
+            {
+                path.evaluate(move);
+                if (move.cost_diff >= best.cost_diff)
+                    return;
+
+                // Aspiration: a tabu move is allowed if it gives a new best path.
+                if (is_tabu(path, move, iter) && actual_cost + move.cost_diff >= min_cost)
+                    return;
+
+                best = move;
+            });
+
+            // Everything is tabu, forget it.
+            if (best.cost_diff == std::numeric_limits<std::int32_t>::max())
+            {
+                m_tabu.assign(table_size, 0);
+                continue;
+            }
+
+            make_tabu(path, best, iter + tenure + static_cast<std::uint32_t>(rng() % (tenure / 2 + 1)));
+            path.apply(best);
+            ++stats.accepted[best.method];
+            actual_cost += best.cost_diff;
+
+            if (actual_cost < min_cost)
+            {
+                min_path = path;
+                min_cost = actual_cost;
+                last_improvement = iter;
+
+                if (context.stream && context.stream->wants(min_cost))
+                {
+                    path.route(min_route);
+                    context.stream->publish(min_cost, min_route);
+                }
+
+                if (context.snapshot && context.snapshot->wants(min_cost))
+                {
+                    path.route(min_route);
+                    context.snapshot->publish(min_cost, min_route);
+                }
+            }
+            else if (iter - last_improvement > stall)
+            {
+                path = min_path;
+                actual_cost = min_cost + perturb(path, last, rng);
+                last_improvement = iter;
+                m_tabu.assign(table_size, 0);
+            }
+        }
+        stats.iterations = iter;
+
+        path = min_path;
+        assert(min_cost == path.cost());
+
+        if (context.stream)
+        {
+            path.route(min_route);
+            context.stream->publish_final(min_cost, min_route);
+        }
+        return stats;
+    }
+
+private:
+    static constexpr std::size_t table_size = 1 << 16;
+
+    // The neighbourhood by the operators of the path, the days are 1..last.
+    template <typename Fn>
+    static void for_each_move(const Path & path, index_t last, Fn && fn)
+    {
+        move_t move = {SWAP_AREAS, 0, 0, 0, 0, 0};
+        for (index_t i = 1; i <= last; ++i)
+        {
+            for (index_t j = 1; j <= last; ++j)
+            {
+                move.i = i;
+                move.j = j;
+                if ((Path::ops & USE_SWAP) && i < j)
+                {
+                    move.method = SWAP_AREAS;
+                    fn(move);
+                }
+
+                // Up to 30 days (as the annealing), the neighbours are already swapped.
+                if ((Path::ops & USE_INSERT) && i != j && std::max(i, j) - std::min(i, j) <= 30)
+                {
+                    move.method = INSERT_AREA;
+                    fn(move);
+                }
+
+                if ((Path::ops & USE_REVERSE) && i + 1 < j && j - i <= 30)
+                {
+                    move.method = REVERSE_AREAS;
+                    fn(move);
+                }
+            }
+        }
+
+        for (const auto & choice : path.city_choices())
+        {
+            move.method = SELECT_CITY;
+            move.i = choice.zone_idx;
+            move.j = choice.city_pos;
+            fn(move);
+        }
+    }
+
+    // Attributes: the area at the day, the city of the area.
+    std::uint32_t & attribute(std::uint64_t kind, std::uint64_t area, std::uint64_t value)
+    {
+        return m_tabu[remix((kind << 62) ^ (area << 32) ^ value) & (table_size - 1)];
+    }
+
+    // Whether the move gives any area an attribute it has recently left.
+    bool is_tabu(const Path & path, const move_t & move, std::uint32_t iter)
+    {
+        switch (move.method)
+        {
+        case SWAP_AREAS:
+            return attribute(0, path.area_at(move.i), move.j) > iter || attribute(0, path.area_at(move.j), move.i) > iter;
+        case REVERSE_AREAS:
+            // Every area of the segment moves to the mirrored day.
+            for (auto m = move.i; m <= move.j; ++m)
+                if (attribute(0, path.area_at(m), move.i + move.j - m) > iter)
+                    return true;
+            return false;
+        case INSERT_AREA:
+            return attribute(0, path.area_at(move.i), move.j) > iter;
+        case SELECT_CITY:
+            return attribute(1, move.i, path.city_of(move.i, move.j)) > iter;
+        default:
+            return false;
+        }
+    }
+
+    // The attributes the move leaves are tabu until the given iteration.
+    void make_tabu(const Path & path, const move_t & move, std::uint32_t until)
+    {
+        switch (move.method)
+        {
+        case SWAP_AREAS:
+            attribute(0, path.area_at(move.i), move.i) = until;
+            attribute(0, path.area_at(move.j), move.j) = until;
+            break;
+        case REVERSE_AREAS:
+            for (auto m = move.i; m <= move.j; ++m)
+                attribute(0, path.area_at(m), m) = until;
+            break;
+        case INSERT_AREA:
+            attribute(0, path.area_at(move.i), move.i) = until;
+            break;
+        case SELECT_CITY:
+            attribute(1, move.i, path.city_of(move.i, 0)) = until;
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Iteration until which the attribute with the hash is tabu.
+    std::vector<std::uint32_t> m_tabu;
+};
+
+template <typename Path>
+constexpr std::size_t tabu_search_t<Path>::table_size;
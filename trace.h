@@ -0,0 +1,169 @@
+/**
+ * @author Petr Lavicka
+ * @copyright
+ * @file
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Timeline of the phases of the run written as Chrome trace_event JSON (open
+// it in chrome://tracing or in the Perfetto UI). Nothing is recorded until it
+// is enabled, the events are kept in memory and written at the end.
+class trace_t
+{
+public:
+    typedef std::chrono::high_resolution_clock clock_t;
+
+    explicit trace_t(clock_t::time_point start_time = clock_t::now())
+        : m_start_time{start_time}
+    {
+    }
+
+    void enable() noexcept
+    {
+        m_enabled = true;
+    }
+
+    bool enabled() const noexcept
+    {
+        return m_enabled;
+    }
+
+    // Complete event of the calling thread, the arguments are the members of a JSON object.
+    void add(const char * name, clock_t::time_point begin, clock_t::time_point end, std::string args = std::string())
+    {
+        event_t event{name, thread_id(), to_us(begin), to_us(end) - to_us(begin), std::move(args)};
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.push_back(std::move(event));
+    }
+
+    // Name of the calling thread in the viewer.
+    void name_thread(const std::string & name)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_threads.emplace_back(thread_id(), name);
+    }
+
+    // Appends the argument to the members of a JSON object.
+    static void arg(std::string & args, const char * key, double value)
+    {
+        if (!args.empty())
+            args += ',';
+        args += '"';
+        args += key;
+        args += "\":";
+        args += std::to_string(value);
+    }
+
+    bool write(const std::string & filename)
+    {
+        std::ofstream out(filename, std::ios::trunc);
+        if (!out)
+            return false;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        out << std::fixed << std::setprecision(3);
+        out << "{\"traceEvents\":[" << std::endl;
+
+        auto separator = "";
+        for (const auto & thread : m_threads)
+        {
+            out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.first
+                << ",\"args\":{\"name\":\"" << thread.second << "\"}}";
+            separator = ",\n";
+        }
+
+        for (const auto & event : m_events)
+        {
+            out << separator << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.tid
+                << ",\"ts\":" << event.ts << ",\"dur\":" << event.dur << ",\"args\":{" << event.args << "}}";
+            separator = ",\n";
+        }
+
+        out << std::endl << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+        return static_cast<bool>(out);
+    }
+
+private:
+    struct event_t
+    {
+        const char * name;
+        unsigned int tid;
+        double ts;
+        double dur;
+        std::string args;
+    };
+
+    // Small numbers of the threads in the order they record.
+    static unsigned int thread_id()
+    {
+        static std::atomic<unsigned int> next_id{0};
+        thread_local unsigned int id = next_id++;
+        return id;
+    }
+
+    double to_us(clock_t::time_point time) const
+    {
+        return std::chrono::duration<double, std::micro>(time - m_start_time).count();
+    }
+
+    const clock_t::time_point m_start_time;
+    bool m_enabled = false;
+
+    std::mutex m_mutex;
+    std::vector<event_t> m_events;
+    std::vector<std::pair<unsigned int, std::string>> m_threads;
+};
+
+// The trace of the program.
+extern trace_t g_trace;
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Records the event from the construction to the destruction (when the trace
+// is enabled).
+class trace_scope_t
+{
+public:
+    explicit trace_scope_t(const char * name)
+        : m_name{name}
+        , m_begin{g_trace.enabled() ? trace_t::clock_t::now() : trace_t::clock_t::time_point()}
+    {
+    }
+
+    trace_scope_t(const trace_scope_t &) = delete;
+    trace_scope_t & operator=(const trace_scope_t &) = delete;
+
+    ~trace_scope_t()
+    {
+        if (g_trace.enabled())
+            g_trace.add(m_name, m_begin, trace_t::clock_t::now(), std::move(m_args));
+    }
+
+    void arg(const char * key, double value)
+    {
+        if (g_trace.enabled())
+            trace_t::arg(m_args, key, value);
+    }
+
+private:
+    const char * m_name;
+    const trace_t::clock_t::time_point m_begin;
+    std::string m_args;
+};
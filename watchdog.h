@@ -0,0 +1,183 @@
+/**
+ * @author Petr Lavicka
+ * @copyright
+ * @file
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "city.h"
+#include "matrix.h"
+#include "stream.h"
+
+// Cleared to stop the annealing (checked at the temperature recompute only).
+extern std::atomic<bool> g_continue_run;
+
+// Set asynchronously (by a signal) to dump the best path found so far.
+extern std::atomic<bool> g_dump_request;
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// The best route found so far, the chains hand it over at the temperature
+// recompute when they improve.
+class snapshot_t
+{
+public:
+    // Cheap check whether the cost is worth publishing.
+    bool wants(std::uint32_t cost) const noexcept
+    {
+        return cost < m_cost.load(std::memory_order_relaxed);
+    }
+
+    void publish(std::uint32_t cost, const std::vector<std::uint16_t> & route)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (cost >= m_cost.load(std::memory_order_relaxed))
+            return;
+
+        m_route.assign(route.begin(), route.end());
+        m_cost.store(cost, std::memory_order_relaxed);
+    }
+
+    std::uint32_t cost() const noexcept
+    {
+        return m_cost.load(std::memory_order_relaxed);
+    }
+
+    // Returns false if there is nothing yet.
+    bool get(std::vector<std::uint16_t> & route)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        route = m_route;
+        return !route.empty();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<std::uint16_t> m_route;
+    std::atomic<std::uint32_t> m_cost{std::numeric_limits<std::uint32_t>::max()};
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Stops the annealing at the deadline and makes sure a result is printed in
+// time: if the program doesn't print the result within the latency after the
+// stop (the deadline or a signal), the watchdog prints the snapshot and ends
+// the process. It also serves the dump requests (to stderr) and stops the run
+// early when the snapshot reaches the lower bound (it is optimal then).
+class watchdog_t
+{
+public:
+    typedef std::chrono::high_resolution_clock clock_t;
+
+    watchdog_t(clock_t::time_point deadline, std::chrono::milliseconds latency,
+               const cities_map_t * cities_indexer, const matrix<std::uint16_t> * costs_matrix)
+        : m_deadline{deadline}
+        , m_latency{latency}
+        , m_cities_indexer{cities_indexer}
+        , m_costs{costs_matrix}
+        , m_thread([this]{ watch_loop(); })
+    {
+    }
+
+    watchdog_t(const watchdog_t &) = delete;
+    watchdog_t & operator=(const watchdog_t &) = delete;
+
+    // Waits for the deadline (as the plain timer did).
+    ~watchdog_t()
+    {
+        m_thread.join();
+    }
+
+    snapshot_t & snapshot() noexcept
+    {
+        return m_snapshot;
+    }
+
+    void set_lower_bound(std::uint32_t bound) noexcept
+    {
+        m_lower_bound.store(bound, std::memory_order_relaxed);
+    }
+
+    // The program prints the result itself, returns with the output lock held.
+    std::unique_lock<std::mutex> claim_output()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_printed = true;
+        m_cv.notify_one();
+        return lock;
+    }
+
+private:
+    void watch_loop()
+    {
+        using namespace std::chrono_literals;
+
+        std::vector<std::uint16_t> route;
+        auto stop_time = clock_t::time_point::max();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            // Polls for the signals, the period bounds the latency of the reaction.
+            m_cv.wait_for(lock, 5ms);
+
+            auto now = clock_t::now();
+            if (g_dump_request.exchange(false) && m_snapshot.get(route))
+                print_route(std::cerr, route, *m_cities_indexer, *m_costs);
+
+            if (now >= m_deadline || m_snapshot.cost() <= m_lower_bound.load(std::memory_order_relaxed))
+                g_continue_run = false;
+
+            if (stop_time == clock_t::time_point::max() && !g_continue_run)
+                stop_time = now;
+
+            if (m_printed)
+            {
+                // Keep the timer semantics, the program ends at the deadline.
+                if (now >= m_deadline || stop_time != clock_t::time_point::max())
+                    return;
+                continue;
+            }
+
+            if (stop_time != clock_t::time_point::max() && now >= stop_time + m_latency && m_snapshot.get(route))
+            {
+                std::cerr << "The result is late, printing the last snapshot." << std::endl;
+                print_route(std::cout, route, *m_cities_indexer, *m_costs);
+                std::cout.flush();
+                std::_Exit(0);
+            }
+        }
+    }
+
+    const clock_t::time_point m_deadline;
+    const std::chrono::milliseconds m_latency;
+
+    snapshot_t m_snapshot;
+    std::atomic<std::uint32_t> m_lower_bound{0};
+
+    // Guards the standard output.
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_printed = false;
+
+    // A sources of data.
+    const cities_map_t * m_cities_indexer;
+    const matrix<std::uint16_t> * m_costs;
+
+    // Must be the last one, it uses all the members above.
+    std::thread m_thread;
+};